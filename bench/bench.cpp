@@ -0,0 +1,411 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <opencv.hpp>
+
+#include "../inc/ER.h"
+#include "../inc/OCR.h"
+#include "../inc/adaboost.h"
+#include "../inc/utils.h"
+#include "../inc/svm.h"
+
+
+using namespace std;
+using namespace cv;
+
+
+// Stage-level benchmarks over res/ICDAR2015_test, run from the directory of the models like canny_text.
+// usage: bench [label] [image_num] [repeat]
+// Every benchmark runs WARMUP untimed and repeat timed repetitions over the same inputs, the setup
+// and cleanup of a repetition (fresh ER trees, freeing them) are not timed. The results are printed
+// and appended to bench_result.tsv, one line per benchmark tagged with the label (e.g. the commit),
+// so runs of different commits can be compared line by line.
+
+#define BENCH_WARMUP 2
+#define BENCH_REPEAT 10
+#define BENCH_IMAGE_NUM 20
+#define BENCH_RESULT_FILE "bench_result.tsv"
+
+
+struct BenchResult
+{
+	string name;
+	long long op_num;			// operations in one repetition
+	vector<double> rep_time;	// seconds of every timed repetition
+};
+
+
+// input of the stage benchmarks, the output of every stage of text_detect on one image
+struct BenchImage
+{
+	Mat src;
+	Mat Ycrcb;
+	vector<Mat> channel;
+	ERs root;
+	vector<ERs> all;
+	vector<ERs> pool;
+	vector<ERs> strong;
+	vector<ERs> weak;
+	ERs tracked;
+	vector<Text> text;
+};
+
+
+static BenchResult run_bench(const string &name, long long op_num, int repeat, function<void()> fn,
+							function<void()> setup = nullptr, function<void()> cleanup = nullptr)
+{
+	BenchResult result;
+	result.name = name;
+	result.op_num = max(1LL, op_num);
+
+	for (int r = 0; r < BENCH_WARMUP + repeat; r++)
+	{
+		if (setup)
+			setup();
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		fn();
+		const double t = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+		if (cleanup)
+			cleanup();
+		if (r >= BENCH_WARMUP)
+			result.rep_time.push_back(t);
+	}
+
+	vector<double> sorted = result.rep_time;
+	sort(sorted.begin(), sorted.end());
+	const double per_op = sorted[sorted.size() / 2] / result.op_num;
+	std::cout << name << ": " << per_op * 1e6 << "us/op (" << result.op_num << " ops, min " << sorted.front() / result.op_num * 1e6 << "us)" << endl;
+	return result;
+}
+
+
+static void write_results(const string &label, const vector<BenchResult> &results)
+{
+	const bool exists = ifstream(BENCH_RESULT_FILE).good();
+	fstream fout(BENCH_RESULT_FILE, fstream::out | fstream::app);
+	if (!exists)
+		fout << "label\ttime\tbenchmark\tops\tmedian_us\tmin_us\tmean_us\tops_per_sec\n";
+
+	char time_buf[32];
+	const time_t now = time(nullptr);
+	strftime(time_buf, sizeof(time_buf), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	for (auto &it : results)
+	{
+		vector<double> sorted = it.rep_time;
+		sort(sorted.begin(), sorted.end());
+		double mean = 0;
+		for (auto t : sorted)
+			mean += t;
+		mean /= sorted.size();
+
+		const double median = sorted[sorted.size() / 2] / it.op_num;
+		fout << label << "\t" << time_buf << "\t" << it.name << "\t" << it.op_num << "\t"
+			<< median * 1e6 << "\t" << sorted.front() / it.op_num * 1e6 << "\t" << mean / it.op_num * 1e6 << "\t"
+			<< 1.0 / median << "\n";
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string label = (argc >= 2) ? argv[1] : "unlabeled";
+	const int image_num = (argc >= 3) ? max(1, atoi(argv[2])) : BENCH_IMAGE_NUM;
+	const int repeat = (argc >= 4) ? max(1, atoi(argv[3])) : BENCH_REPEAT;
+
+	ERFilter* er_filter = new ERFilter(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+	er_filter->stc = new CascadeBoost("er_classifier/strong.classifier");
+	er_filter->wtc = new CascadeBoost("er_classifier/weak.classifier");
+	er_filter->ocr = new OCR("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	er_filter->load_tp_table("dictionary/tp_table.txt");
+	er_filter->corrector = new SpellingCorrector();
+	if (!er_filter->corrector->load("dictionary/big.dict"))
+		er_filter->corrector->load("dictionary/big.txt");
+	er_filter->set_ocr_top_k(OCR_CANDIDATE_NUM);
+	er_filter->set_beam_width(OCR_BEAM_WIDTH);
+	er_filter->lexicon = new Lexicon();
+	if (!er_filter->lexicon->load("dictionary/big.lex"))
+	{
+		delete er_filter->lexicon;
+		er_filter->lexicon = nullptr;
+	}
+	er_filter->set_thread_num(1);	// the stage benchmarks time one thread
+
+	// run the stages once on every image to get the inputs of the later stages
+	vector<BenchImage> images;
+	for (int n = 1; n <= 328 && images.size() < image_num; n++)
+	{
+		BenchImage b;
+		if (!load_challenge2_test_file(b.src, n))	continue;
+
+		er_filter->compute_channels(b.src, b.Ycrcb, b.channel);
+		const int ch_num = b.channel.size();
+		b.root.resize(ch_num);
+		b.all.resize(ch_num);
+		b.pool.resize(ch_num);
+		b.strong.resize(ch_num);
+		b.weak.resize(ch_num);
+		for (int i = 0; i < ch_num; i++)
+		{
+			b.root[i] = er_filter->er_tree_extract(b.channel[i]);
+			er_filter->non_maximum_supression(b.root[i], b.all[i], b.pool[i], b.channel[i]);
+			er_filter->classify(b.pool[i], b.strong[i], b.weak[i], b.channel[i]);
+		}
+		er_filter->er_track(b.strong, b.weak, b.tracked, b.channel, b.Ycrcb);
+		ERs grouped = b.tracked;
+		er_filter->er_grouping(grouped, b.text, false, true);
+		images.push_back(b);
+	}
+
+	if (images.empty())
+	{
+		cerr << "ERROR! No image of res/ICDAR2015_test could be loaded\n";
+		return -1;
+	}
+	std::cout << "Images: " << images.size() << ", warmup: " << BENCH_WARMUP << ", repetitions: " << repeat << "\n\n";
+
+	vector<BenchResult> results;
+	long long ch_op = 0;
+	long long pool_op = 0;
+	long long glyph_op = 0;
+	for (auto &b : images)
+	{
+		ch_op += b.channel.size();
+		for (auto &p : b.pool)
+			pool_op += p.size();
+		for (auto &t : b.text)
+			glyph_op += t.ers.size();
+	}
+
+
+	// compute_channels
+	results.push_back(run_bench("compute_channels", images.size(), repeat, [&]() {
+		Mat Ycrcb;
+		vector<Mat> channel;
+		for (auto &b : images)
+			er_filter->compute_channels(b.src, Ycrcb, channel);
+	}));
+
+
+	// er_tree_extract per THRESH_STEP
+	const int thresh_steps[] = { 1, 2, 4, 8, 16 };
+	for (auto step : thresh_steps)
+	{
+		ERFilter step_filter(step, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+		ERs roots;
+		results.push_back(run_bench("er_tree_extract/thresh_step=" + to_string(step), ch_op, repeat, [&]() {
+			for (auto &b : images)
+				for (auto &c : b.channel)
+					roots.push_back(step_filter.er_tree_extract(c));
+		}, nullptr, [&]() {
+			for (auto it : roots)
+				step_filter.er_delete(it);
+			roots.clear();
+		}));
+	}
+
+
+	// non_maximum_supression, it marks the tree so every repetition gets fresh trees
+	{
+		vector<ERs> trees(images.size());
+		results.push_back(run_bench("non_maximum_supression", ch_op, repeat, [&]() {
+			ERs all;
+			ERs pool;
+			for (int k = 0; k < images.size(); k++)
+			{
+				for (int i = 0; i < images[k].channel.size(); i++)
+				{
+					all.clear();
+					pool.clear();
+					er_filter->non_maximum_supression(trees[k][i], all, pool, images[k].channel[i]);
+				}
+			}
+		}, [&]() {
+			for (int k = 0; k < images.size(); k++)
+				for (auto &c : images[k].channel)
+					trees[k].push_back(er_filter->er_tree_extract(c));
+		}, [&]() {
+			for (auto &t : trees)
+			{
+				for (auto it : t)
+					er_filter->er_delete(it);
+				t.clear();
+			}
+		}));
+	}
+
+
+	// make_LBP_hist and CascadeBoost::predict on the ERs that survive NMS
+	vector<vector<double>> lbp_fv;
+	for (auto &b : images)
+		for (int i = 0; i < b.pool.size(); i++)
+			for (auto it : b.pool[i])
+				lbp_fv.push_back(ERFilter::make_LBP_hist(b.channel[i](it->bound), 2, 24));
+
+	results.push_back(run_bench("make_LBP_hist", pool_op, repeat, [&]() {
+		for (auto &b : images)
+			for (int i = 0; i < b.pool.size(); i++)
+				for (auto it : b.pool[i])
+					ERFilter::make_LBP_hist(b.channel[i](it->bound), 2, 24);
+	}));
+
+	volatile double sink = 0;
+	results.push_back(run_bench("CascadeBoost::predict/strong", lbp_fv.size(), repeat, [&]() {
+		for (auto &fv : lbp_fv)
+			sink = sink + er_filter->stc->predict(fv);
+	}));
+	results.push_back(run_bench("CascadeBoost::predict/weak", lbp_fv.size(), repeat, [&]() {
+		for (auto &fv : lbp_fv)
+			sink = sink + er_filter->wtc->predict(fv);
+	}));
+
+
+	// er_track only writes features that it computes again
+	results.push_back(run_bench("er_track", images.size(), repeat, [&]() {
+		for (auto &b : images)
+		{
+			ERs tracked;
+			er_filter->er_track(b.strong, b.weak, tracked, b.channel, b.Ycrcb);
+		}
+	}));
+
+
+	// er_grouping merges the boxes of overlapping ERs, they are restored before every repetition
+	{
+		vector<pair<Rect, Point>> saved;
+		for (auto &b : images)
+			for (auto it : b.tracked)
+				saved.push_back(make_pair(it->bound, it->center));
+
+		results.push_back(run_bench("er_grouping", images.size(), repeat, [&]() {
+			for (auto &b : images)
+			{
+				ERs all_er = b.tracked;
+				vector<Text> text;
+				er_filter->er_grouping(all_er, text, false, true);
+			}
+		}, [&]() {
+			int k = 0;
+			for (auto &b : images)
+			{
+				for (auto it : b.tracked)
+				{
+					it->bound = saved[k].first;
+					it->center = saved[k].second;
+					++k;
+				}
+			}
+		}));
+	}
+
+
+	// OCR::chain_run on the letters of the grouped lines, without the OCR cache
+	results.push_back(run_bench("OCR::chain_run", glyph_op, repeat, [&]() {
+		for (auto &b : images)
+		{
+			for (auto &t : b.text)
+			{
+				for (auto it : t.ers)
+				{
+					Mat glyph = b.channel[it->ch](it->bound);
+					sink = sink + er_filter->ocr->chain_run(glyph, it->level * THRESHOLD_STEP);
+				}
+			}
+		}
+	}));
+
+
+	// svm_predict_probability on the chain-code features of the same letters, libsvm OCR models only
+	SVMClassifier *svm = dynamic_cast<SVMClassifier*>(er_filter->ocr->get_classifier());
+	if (svm != nullptr && svm->get_model() != nullptr)
+	{
+		const int dim = er_filter->ocr->get_feature_dim() + 1;
+		vector<svm_node> features;
+		for (auto &b : images)
+		{
+			for (auto &t : b.text)
+			{
+				for (auto it : t.ers)
+				{
+					Mat ocr_img;
+					threshold(255 - b.channel[it->ch](it->bound), ocr_img, it->level * THRESHOLD_STEP, 255, CV_THRESH_OTSU);
+					OCR::ARAN(ocr_img, ocr_img, OCR_IMG_L);
+					features.resize(features.size() + dim);
+					er_filter->ocr->chain_feature(ocr_img, &features[features.size() - dim]);
+				}
+			}
+		}
+
+		svm_model *model = svm->get_model();
+		vector<double> prob(svm_get_nr_class(model));
+		results.push_back(run_bench("svm_predict_probability", features.size() / dim, repeat, [&]() {
+			for (size_t i = 0; i < features.size(); i += dim)
+				sink = sink + svm_predict_probability(model, &features[i], prob.data());
+		}));
+	}
+	else
+	{
+		std::cout << "svm_predict_probability: skipped, the OCR model is not a libsvm model" << endl;
+	}
+
+
+	// SpellingCorrector::correct on the typical OCR errors of some common words
+	{
+		const vector<string> words = { "EXlT", "0PEN", "PARKlNG", "STRET", "HOTEI", "CAFE", "BANKK", "SALE", "ENTRANCF", "T0ILET",
+										"STATI0N", "MARKEr", "PUSH", "PULI", "WELCOME", "SH0P", "CLOSEO", "RESTAURAMT", "FIRE", "0FFICE" };
+		results.push_back(run_bench("SpellingCorrector::correct", words.size(), repeat, [&]() {
+			for (auto &w : words)
+				sink = sink + er_filter->corrector->correct(w).size();
+		}));
+	}
+
+
+	// end to end, every image through text_detect with the OpenMP threads of the machine
+	{
+		er_filter->set_thread_num(0);
+		vector<ERs> roots(images.size());
+		vector<double> stage_time(7, 0);
+		BenchResult e2e = run_bench("text_detect", images.size(), repeat, [&]() {
+			for (int k = 0; k < images.size(); k++)
+			{
+				vector<ERs> all, pool, strong, weak;
+				ERs tracked;
+				vector<Text> text;
+				vector<double> times = er_filter->text_detect(images[k].src, roots[k], all, pool, strong, weak, tracked, text);
+				for (int i = 0; i < times.size(); i++)
+					stage_time[i] += times[i];
+			}
+		}, nullptr, [&]() {
+			for (auto &r : roots)
+			{
+				for (auto it : r)
+					er_filter->er_delete(it);
+				r.clear();
+			}
+		});
+		results.push_back(e2e);
+
+		vector<double> sorted = e2e.rep_time;
+		sort(sorted.begin(), sorted.end());
+		std::cout << "text_detect throughput: " << images.size() / sorted[sorted.size() / 2] << " images/s\n";
+		Profiler::print_stage_time(std::cout, stage_time, (BENCH_WARMUP + repeat) * images.size());
+	}
+
+	write_results(label, results);
+	std::cout << "\nResults appended to " << BENCH_RESULT_FILE << endl;
+
+	for (auto &b : images)
+		for (auto it : b.root)
+			er_filter->er_delete(it);
+	delete er_filter->wtc;
+	delete er_filter->stc;
+	delete er_filter->ocr;
+	delete er_filter->corrector;
+	delete er_filter->lexicon;
+	delete er_filter;
+	return 0;
+}
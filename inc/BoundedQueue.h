@@ -0,0 +1,131 @@
+#ifndef __BOUNDED_QUEUE__
+#define __BOUNDED_QUEUE__
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+
+// Blocking FIFO of at most capacity items between two pipeline stages. push waits while the queue is
+// full, pop waits while it is empty; after close() push fails and pop drains what is left, then fails.
+// The occupancy seen by every push is accumulated, a queue that is always full points at a slow
+// consumer and one that is always empty at a slow producer.
+template <typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(size_t _capacity) : capacity(_capacity > 0 ? _capacity : 1), closed(false),
+									push_count(0), occupancy_sum(0), occupancy_max(0), full_wait(0), empty_wait(0) {}
+
+	bool push(T item)
+	{
+		unique_lock<mutex> guard(lock);
+		if (items.size() >= capacity && !closed)
+		{
+			++full_wait;
+			not_full.wait(guard, [this]() { return items.size() < capacity || closed; });
+		}
+		if (closed)
+			return false;
+
+		items.push_back(move(item));
+		++push_count;
+		occupancy_sum += items.size();
+		occupancy_max = max(occupancy_max, items.size());
+		not_empty.notify_one();
+		return true;
+	}
+
+	// never waits, fails when the queue is full or closed, for producers that prefer dropping to stalling
+	bool try_push(T item)
+	{
+		lock_guard<mutex> guard(lock);
+		if (items.size() >= capacity || closed)
+			return false;
+
+		items.push_back(move(item));
+		++push_count;
+		occupancy_sum += items.size();
+		occupancy_max = max(occupancy_max, items.size());
+		not_empty.notify_one();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		unique_lock<mutex> guard(lock);
+		if (items.empty() && !closed)
+		{
+			++empty_wait;
+			not_empty.wait(guard, [this]() { return !items.empty() || closed; });
+		}
+		if (items.empty())
+			return false;
+
+		item = move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		lock_guard<mutex> guard(lock);
+		closed = true;
+		not_full.notify_all();
+		not_empty.notify_all();
+	}
+
+	size_t size()
+	{
+		lock_guard<mutex> guard(lock);
+		return items.size();
+	}
+
+	size_t get_capacity() { return capacity; }
+
+	// average and maximum number of items right after a push
+	double mean_occupancy()
+	{
+		lock_guard<mutex> guard(lock);
+		return push_count ? (double)occupancy_sum / push_count : 0;
+	}
+
+	size_t max_occupancy()
+	{
+		lock_guard<mutex> guard(lock);
+		return occupancy_max;
+	}
+
+	// how many times the producer waited on a full queue and the consumers on an empty one
+	unsigned long long get_full_wait()
+	{
+		lock_guard<mutex> guard(lock);
+		return full_wait;
+	}
+
+	unsigned long long get_empty_wait()
+	{
+		lock_guard<mutex> guard(lock);
+		return empty_wait;
+	}
+
+private:
+	mutex lock;
+	condition_variable not_full;
+	condition_variable not_empty;
+	deque<T> items;
+	const size_t capacity;
+	bool closed;
+
+	unsigned long long push_count;
+	unsigned long long occupancy_sum;
+	size_t occupancy_max;
+	unsigned long long full_wait;
+	unsigned long long empty_wait;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __CHANGE_DETECTOR__
+#define __CHANGE_DETECTOR__
+
+#include <vector>
+
+#include <opencv.hpp>
+#include "ER.h"
+
+using namespace std;
+using namespace cv;
+
+
+// Text detection restricted to the parts of the frame that changed. The grey frame is compared to a
+// reference tile by tile with the sum of absolute differences (SSE2 psadbw when available), changed
+// tiles are dilated by one tile and grouped into rectangles, and text_detect runs on those rectangles
+// only. Cached text outside them is kept as it is; a rectangle that touches a cached text box grows to
+// cover it, so a line is always detected as a whole. The reference is updated where the frame was
+// processed, so a slow change still adds up, and the whole frame is processed every refresh_interval frames.
+class ChangeDetector
+{
+public:
+	ChangeDetector(ERFilter *_er_filter, int tile_size = 32, double change_t = 8, int refresh_interval = 100);
+
+	void process(Mat &frame, vector<Text> &text);		// text of the whole frame, it has no ers
+	void force_refresh();
+	double get_processed_fraction();					// pixels processed / frame pixels of the last frame
+	double get_mean_processed_fraction();
+	static unsigned tile_sad(const uchar *a, const uchar *b, const int step_a, const int step_b, const int width, const int height);
+
+private:
+	ERFilter *er_filter;
+
+	//! Parameters
+	int TILE_SIZE;
+	double CHANGE_T;			// mean absolute difference of a changed tile, grey levels
+	int REFRESH_INTERVAL;
+
+	Mat reference;
+	vector<Text> cache;
+	int since_refresh;
+	bool need_refresh;
+	double processed_fraction;
+	double processed_sum;
+	unsigned long long frame_count;
+
+	void change_regions(Mat &gray, vector<Rect> &regions);
+	void detect_region(Mat &frame, const Rect &region, vector<Text> &text);
+};
+
+#endif
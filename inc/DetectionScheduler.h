@@ -0,0 +1,73 @@
+#ifndef __DETECTION_SCHEDULER__
+#define __DETECTION_SCHEDULER__
+
+#include <vector>
+#include <chrono>
+
+#include <opencv.hpp>
+#include "ER.h"
+
+using namespace std;
+using namespace cv;
+
+
+// Runs the full text_detect only on keyframes and follows the text boxes of the last keyframe on the
+// frames in between by template matching the keyframe patch of every box around its last position.
+// A keyframe is forced when a box is lost (low match score or out of the frame), when a box drifted
+// too far from its keyframe position, or when the downscaled frame differs too much from the keyframe
+// (scene change). Otherwise the keyframe interval is the smallest one that keeps the mean cost per
+// frame within 1 / target_fps, estimated from the running detect and track times.
+class DetectionScheduler
+{
+public:
+	DetectionScheduler(ERFilter *_er_filter, double target_fps = 20, int max_interval = 30);
+
+	// the text of the frame, returns true when it was a keyframe. Text on a tracked frame has no ers.
+	bool process(Mat &frame, vector<Text> &text);
+	void force_keyframe();
+	void set_target_fps(double fps);
+	void set_track_param(double min_score, double max_drift, double scene_change_t);
+	int get_interval();
+	unsigned long long get_keyframe_count();
+	unsigned long long get_tracked_count();
+	double get_detect_time();	// running mean seconds of a keyframe
+	double get_track_time();	// running mean seconds of a tracked frame
+	const vector<double>& get_detect_times();	// text_detect times of the last keyframe
+
+private:
+	struct Track
+	{
+		Text text;
+		Rect key_box;		// box on the keyframe
+		Mat patch;			// grey patch of the keyframe, the template
+	};
+
+	ERFilter *er_filter;
+
+	//! Parameters
+	double TARGET_FPS;
+	int MAX_INTERVAL;
+	double MIN_MATCH_SCORE;		// normalized cross correlation
+	double MAX_DRIFT;			// displacement from the keyframe box in box heights
+	double SCENE_CHANGE_T;		// mean absolute difference of the thumbnails, grey levels
+	static const int THUMB_SCALE = 8;
+
+	int interval;
+	int since_keyframe;
+	bool need_keyframe;
+	Mat key_thumb;
+	vector<Track> tracks;
+
+	double detect_time;
+	double track_time;
+	vector<double> detect_times;
+	unsigned long long keyframe_count;
+	unsigned long long tracked_count;
+
+	void detect(Mat &frame, Mat &gray, vector<Text> &text);
+	bool track(Mat &gray, vector<Text> &text);
+	bool scene_changed(Mat &thumb);
+	void update_interval();
+};
+
+#endif
@@ -19,14 +19,31 @@
 #include "adaboost.h"
 #include "OCR.h"
 #include "SpellingCorrector.h"
-
-#define DO_OCR
-//#define GET_ALL_ER
-//#define USE_STROKE_WIDTH
+#include "Lexicon.h"
+#include "Profiler.h"
 
 using namespace std;
 using namespace cv;
 
+
+// Optional features of the pipeline, chosen at run time with ERFilter::set_pipeline
+enum PipelineFeature
+{
+	PIPELINE_OCR = 1,				// er_ocr after the grouping, otherwise detection only
+	PIPELINE_STROKE_WIDTH = 2,		// stroke width similarity in er_track and er_grouping
+	PIPELINE_ALL_ER = 4				// non_maximum_supression also returns every ER of the tree in all
+};
+
+// Compile-time policy of one feature combination. Every stage is instantiated per combination, so
+// a disabled feature leaves no test or push_back behind in the loops.
+template <int FEATURE>
+struct Pipeline
+{
+	static const bool ocr = (FEATURE & PIPELINE_OCR) != 0;
+	static const bool stroke_width = (FEATURE & PIPELINE_STROKE_WIDTH) != 0;
+	static const bool all_er = (FEATURE & PIPELINE_ALL_ER) != 0;
+};
+
 struct plist 
 {
 	plist() :p(0), next(nullptr) {};
@@ -96,16 +113,55 @@ struct Text
 	string word;
 };
 
-struct GraphNode
+// Candidate graph of a text line in CSR form. Vertex j is text.ers[j], its out edges are
+// adj[offset[j]] ~ adj[offset[j+1]-1] with the transition probability at the same position of edge_prob.
+// The buffers keep their capacity between text lines, clear() only resets the sizes.
+struct Graph
 {
-	GraphNode(ER *v, const int i) : vertex(v), index(i){};
-	ER* vertex;
-	int index;
-	vector<GraphNode> adj_list;
+	void clear()
+	{
+		vertex.clear();
+		label.clear();
+		offset.clear();
+		adj.clear();
+		edge_prob.clear();
+	};
+	int size() const { return vertex.size(); };
+	ERs vertex;
+	vector<int> label;			// index_mapping of the OCR letter of every vertex
+	vector<int> offset;
+	vector<int> adj;
 	vector<double> edge_prob;
-};
 
-typedef vector<GraphNode> Graph;
+	// DP buffers of solve_graph
+	vector<double> score;
+	vector<int> path;
+
+	// beam search buffers, incoming edges in CSR form and the surviving hypotheses of vertex j
+	// in hyp[hyp_offset[j]] ~ hyp[hyp_offset[j+1]-1]
+	struct Hypothesis
+	{
+		double score;
+		int vertex;
+		int cand;		// index in the OCR candidates of vertex
+		int label;		// index_mapping of that candidate
+		int prev;		// index in hyp of the previous hypothesis, -1 for the first letter
+		int lex_begin;	// Levenshtein automaton states in lex_pool (lex_expand before it is kept)
+		int lex_end;
+		int lex_cost;	// edits of the current word from the lexicon so far, -1 when it has left the lexicon
+	};
+	vector<int> in_offset;
+	vector<int> in_vertex;
+	vector<Hypothesis> hyp;
+	vector<int> hyp_offset;
+	vector<Hypothesis> expand;
+	vector<Hypothesis> dead;
+	vector<Lexicon::State> lex_root;
+	vector<Lexicon::State> lex_pool;
+	vector<Lexicon::State> lex_expand;
+	vector<Lexicon::State> lex_step;
+	vector<double> gap;		// non-negative distances between the letters of the edges
+};
 
 class ERFilter
 {
@@ -119,7 +175,8 @@ public:
 	svm_model *st_svm;
 	svm_model *wt_svm;
 	OCR *ocr;
-	SpellingCorrector corrector;
+	SpellingCorrector *corrector;	// not owned, the words are not corrected when it is not set
+	Lexicon *lexicon;		// constrains the beam search when it is set, not owned
 	
 	//! functions
 	vector<double> text_detect(Mat src, ERs &root, vector<ERs> &all, vector<ERs> &pool, vector<ERs> &strong, vector<ERs> &weak, ERs &tracked, vector<Text> &text);
@@ -131,11 +188,21 @@ public:
 	void er_track(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vector<Mat> &channel, Mat Ycrcb);
 	void er_grouping(ERs &all_er, vector<Text> &text, bool overlap_sup = false, bool inner_sup = false);
 	void er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text);
-	vector<double> make_LBP_hist(Mat input, const int N = 2, const int normalize_size = 24);
+	static vector<double> make_LBP_hist(Mat input, const int N = 2, const int normalize_size = 24);
 	bool load_tp_table(const char* filename);
-	Mat calc_LBP(Mat input, const int size = 24);
+	static Mat calc_LBP(Mat input, const int size = 24);
 	void set_thresh_step(int t);
 	void set_min_area(int m);
+	void set_ocr_top_k(int k);
+	void set_beam_width(int b);
+	void set_lexicon_param(int max_edit, double weight);
+	void set_thread_num(int n);
+	void set_channel_mask(int mask);
+	void set_ocr_max_line(int n);
+	void set_pipeline(int features);
+	int get_pipeline();
+	const vector<double>& get_decode_time();
+	void set_group_output(vector<Text> *out);
 	
 
 private:
@@ -146,8 +213,23 @@ private:
 	int STABILITY_T;
 	double OVERLAP_COEF;
 	double MIN_OCR_PROB;
+	int OCR_TOP_K;
+	int BEAM_WIDTH;
+	int LEX_MAX_EDIT;
+	double LEX_WEIGHT;
+	int THREAD_NUM;		// OpenMP threads of the channel and OCR loops, 0 for the OpenMP default
+	int CHANNEL_MASK;	// bit i set when channel i of compute_channels is used
+	int OCR_MAX_LINE;	// OCR only the largest lines, -1 for all of them
+	int PIPELINE;		// PipelineFeature flags
 	enum { right, bottom, left, top };
 
+	//! Stages instantiated for one Pipeline, the public functions dispatch to them once per call
+	template <class Fn> void dispatch(Fn fn);
+	template <class P> vector<double> text_detect_impl(Mat &src, ERs &root, vector<ERs> &all, vector<ERs> &pool, vector<ERs> &strong, vector<ERs> &weak, ERs &tracked, vector<Text> &text);
+	template <class P> void non_maximum_supression_impl(ER *er, ERs &all, ERs &pool, Mat &input);
+	template <class P> void er_track_impl(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vector<Mat> &channel, Mat &Ycrcb);
+	template <class P> void er_grouping_impl(ERs &all_er, vector<Text> &text, bool overlap_sup, bool inner_sup);
+
 	//! ER operation functions
 	inline void er_accumulate(ER *er, const int &current_pixel, const int &x, const int &y);
 	void er_merge(ER *parent, ER *child);
@@ -160,14 +242,18 @@ private:
 	void overlap_suppression(ERs &pool);
 
 	// OCR operation functions
+	void deskew_line(Text &text, vector<Mat> &channel, vector<Mat> &strip, vector<Rect> &glyph_rect);
 	void build_graph(Text &text, Graph &graph);
 	void solve_graph(Text &text, Graph &graph);
+	void beam_search(Text &text, Graph &graph, vector<vector<double>> &candidates);
 	void spell_check(Text &text);
 
 	// feature extract
 	Vec3d color_hist(Mat input);
 
 	double tp[65][65];
+	vector<double> decode_time;	// seconds spent in solve_graph/beam_search of every text line of the last er_ocr
+	vector<Text> *group_output;	// gets the lines of text_detect before er_ocr when it is set, not owned
 };
 
 
@@ -0,0 +1,82 @@
+#ifndef __GOLDEN_OUTPUT__
+#define __GOLDEN_OUTPUT__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+
+#include <opencv.hpp>
+#include "ER.h"
+
+using namespace std;
+using namespace cv;
+
+
+// Output of every stage of text_detect on a set of images, to validate an optimized build or
+// configuration against a reference one. The reference is captured and written once (or captured
+// in the same process with another ERFilter), the candidate is captured the same way and compared.
+// Every stage is compared twice:
+//  exact		the multisets of items are identical (boxes, channels, letters and probabilities bit for bit)
+//  tolerance	items are paired by IoU >= iou_t in the same channel, a pair must have the same letter,
+//				probabilities within prob_tol and words within word_edit edits
+class GoldenOutput
+{
+public:
+	enum Stage { POOL, STRONG, WEAK, TRACKED, GROUP, LETTER, WORD, STAGE_NUM };
+
+	struct Item
+	{
+		int ch;				// channel of the ER, -1 for lines
+		Rect box;
+		double prob;		// OCR probability of a letter, 0 otherwise
+		string label;		// letter, word, or number of ERs of a group
+	};
+
+	struct Image
+	{
+		int index;
+		vector<vector<Item>> stage;		// STAGE_NUM item lists
+	};
+
+	struct StageDiff
+	{
+		int image_num;
+		int exact_image;			// images whose items are identical
+		long long ref_count;
+		long long test_count;
+		long long exact_miss;		// items without an identical item on the other side
+		long long tol_miss;			// items without a pair within the tolerance
+		double max_prob_diff;		// over the paired letters
+	};
+
+	GoldenOutput(double _iou_t = 0.9, double _prob_tol = 1e-3, int _word_edit = 1);
+
+	// runs text_detect on src and keeps the output of every stage
+	void capture(ERFilter *er_filter, Mat &src, int index);
+	bool write(const string &filename);
+	bool read(const string &filename);
+	void clear();
+	const vector<Image>& get_images();
+
+	// this is the reference, the first differences of every stage go to detail
+	vector<StageDiff> compare(GoldenOutput &test, ostream &detail, int max_detail = 20);
+	static void print_report(const vector<StageDiff> &diff, ostream &out);
+	static const char* stage_name(int stage);
+
+private:
+	//! Parameters
+	double IOU_T;
+	double PROB_TOL;
+	int WORD_EDIT;
+
+	vector<Image> images;
+
+	static void add_er(vector<Item> &items, ER *er, int ch);
+	static bool item_less(const Item &a, const Item &b);
+	static bool item_equal(const Item &a, const Item &b);
+	static double iou(const Rect &a, const Rect &b);
+	bool compatible(int stage, const Item &a, const Item &b, double &prob_diff);
+};
+
+#endif
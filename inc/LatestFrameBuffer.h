@@ -0,0 +1,73 @@
+#ifndef __LATEST_FRAME_BUFFER__
+#define __LATEST_FRAME_BUFFER__
+
+#include <atomic>
+#include <chrono>
+#include <opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+
+struct Frame
+{
+	Mat image;
+	chrono::high_resolution_clock::time_point capture_time;
+	unsigned long long index;
+};
+
+
+// Lock-free single-producer / single-consumer ring of 3 frame slots with latest-wins policy.
+// The producer owns the back slot and the consumer the front slot; publish() swaps the back slot with
+// the middle one and acquire() swaps the middle slot with the front one, both with one atomic exchange.
+// A frame that is still in the middle slot when the next one is published is dropped, so acquire()
+// always returns the newest frame and the capture never waits for the processing.
+// Slots are reused, the consumer has to clone what it keeps after its next acquire().
+class LatestFrameBuffer
+{
+public:
+	LatestFrameBuffer() : back(0), front(2), middle(1), closed(false), published(0), dropped(0) {}
+
+	// producer side: fill write_slot(), then hand it over
+	Frame& write_slot() { return slot[back]; }
+
+	void publish()
+	{
+		const unsigned prev = middle.exchange(back | fresh_bit, memory_order_acq_rel);
+		if (prev & fresh_bit)
+			dropped.fetch_add(1, memory_order_relaxed);
+		back = prev & index_mask;
+		published.fetch_add(1, memory_order_relaxed);
+	}
+
+	void close() { closed.store(true, memory_order_release); }
+
+	// consumer side: the newest frame published since the last acquire, nullptr if there is none
+	Frame* acquire()
+	{
+		if (!(middle.load(memory_order_acquire) & fresh_bit))
+			return nullptr;
+
+		const unsigned prev = middle.exchange(front, memory_order_acq_rel);
+		front = prev & index_mask;
+		return &slot[front];
+	}
+
+	bool is_closed() { return closed.load(memory_order_acquire); }
+	unsigned long long get_published() { return published.load(memory_order_relaxed); }
+	unsigned long long get_dropped() { return dropped.load(memory_order_relaxed); }
+
+private:
+	static const unsigned fresh_bit = 4;
+	static const unsigned index_mask = 3;
+
+	Frame slot[3];
+	unsigned back;				// producer only
+	unsigned front;				// consumer only
+	atomic<unsigned> middle;	// slot index, fresh_bit set when it holds a frame not acquired yet
+	atomic<bool> closed;
+	atomic<unsigned long long> published;
+	atomic<unsigned long long> dropped;
+};
+
+#endif
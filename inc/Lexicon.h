@@ -0,0 +1,55 @@
+#ifndef __LEXICON__
+#define __LEXICON__
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+
+// Lexicon of lowercase words stored as a double-array trie. A child of node s with letter code c
+// (1 ~ 26 for 'a' ~ 'z') is t = base[s] + c when check[t] == s; mask[s] has bit c set for every
+// child and bit 0 set when s ends a word, so walking the children needs no probing.
+// About 12 bytes per trie node, a 350k-word dictionary takes a few MB and several lexicons
+// (e.g. per-deployment vocabularies) can stay resident at the same time.
+class Lexicon
+{
+public:
+	// an entry of the Levenshtein automaton, the text read so far is cost edits away from the prefix of node
+	struct State
+	{
+		int node;
+		int cost;
+	};
+
+	Lexicon();
+	bool load(const string &filename, const int min_count = 1);	// binary lexicon written by save() or a text corpus
+	bool save(const string &filename);
+	void build(vector<string> &words);
+	bool contains(const string &word);
+	size_t size();				// number of words
+	size_t node_num();
+
+	// Levenshtein automaton walk. The states of a prefix hold every trie node within max_edit edits
+	// once, with its lowest cost, sorted by cost. step returns false when no dictionary word is
+	// within max_edit edits of any extension of the text.
+	void start(vector<State> &states, const int max_edit);
+	bool step(const State *from, const int from_num, const char letter, vector<State> &to, const int max_edit);
+	int final_cost(const State *states, const int state_num, const int max_edit);	// edits to the closest complete word, max_edit + 1 if none
+
+private:
+	vector<int> base;
+	vector<int> check;
+	vector<unsigned> mask;
+	size_t word_num;
+
+	static int letter_code(const char c);
+	void closure(vector<State> &states, const int max_edit);
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
+#include <float.h>
 #include <time.h>
 #include <iostream>
 #include <fstream>
@@ -11,6 +13,10 @@
 #include <thread>
 #include <chrono>
 #include <numeric>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
 #include <omp.h>
 
 #include <opencv.hpp>
@@ -23,31 +29,175 @@ using namespace cv;
 
 struct Text;
 
+// Bounded LRU of OCR results keyed by a hash of the normalized binary glyph and the slope bucket.
+// Entries are spread over independently locked shards, so concurrent chain_run calls rarely
+// wait on each other. The result is stored the same way chain_top_k returns it (letter + prob, best first).
+class OCRCache
+{
+public:
+	OCRCache(size_t capacity = 4096, int shard_num = 16);
+	bool lookup(const unsigned long long key, vector<double> &result);
+	void insert(const unsigned long long key, const vector<double> &result);
+	void clear();
+	unsigned long long get_hits();
+	unsigned long long get_misses();
+	double hit_rate();
+	static unsigned long long make_key(Mat &glyph, double slope, const int k = 1);
+
+private:
+	typedef list<pair<unsigned long long, vector<double>>> LRUList;
+	struct Shard
+	{
+		mutex lock;
+		LRUList lru;
+		unordered_map<unsigned long long, LRUList::iterator> table;
+		unsigned long long hits = 0;
+		unsigned long long misses = 0;
+	};
+
+	size_t shard_capacity;
+	vector<unique_ptr<Shard>> shards;
+};
+
+
+class OCR;
+
+// Glyph classifier backend of OCR. The input is the ARAN normalized binary glyph (img_L x img_L),
+// the output is the index of the letter in the OCR table and its probability.
+// The glyph is scratch memory of chain_run, a backend is allowed to modify it.
+class OCRClassifier
+{
+public:
+	virtual ~OCRClassifier() {};
+	virtual void predict_top(Mat &glyph, const int k, vector<pair<int, double>> &top) = 0;	// k best (label, prob), best first
+	int predict(Mat &glyph, double &prob);
+	virtual const char* name() = 0;
+
+protected:
+	static void select_top(const double *score, const int n, const int k, vector<pair<int, double>> &top);
+};
+
+
+// libsvm with probability estimates on the chain-code feature, the original OCR backend
+class SVMClassifier : public OCRClassifier
+{
+public:
+	SVMClassifier(OCR *_ocr, const char *svm_file_name);	// _ocr provides the chain-code feature
+	~SVMClassifier();
+	using OCRClassifier::predict;
+	void predict_top(Mat &glyph, const int k, vector<pair<int, double>> &top);
+	void predict_top(svm_node *fv, const int k, vector<pair<int, double>> &top);
+	int predict(svm_node *fv, double &prob);
+	void predict_prob(svm_node *fv, vector<double> &prob);	// probability of every label
+	svm_model* get_model();
+	const char* name() { return "SVM"; }
+
+private:
+	OCR *ocr;
+	svm_model *model;
+};
+
+
+// k nearest neighbours on bit-packed binary glyphs, the distance is the Hamming distance
+// counted with popcount (AVX2 nibble lookup when available). The probability is the
+// distance weighted vote of the winning letter.
+class KNNClassifier : public OCRClassifier
+{
+public:
+	KNNClassifier(int _img_L, int _k = 5);
+	bool load(const char *filename);
+	bool save(const char *filename);
+	void add_sample(Mat &glyph, int label);
+	void predict_top(Mat &glyph, const int n, vector<pair<int, double>> &top);
+	const char* name() { return "kNN"; }
+	size_t size();
+	static bool is_knn_file(const char *filename);
+	static int hamming_distance(const unsigned long long *a, const unsigned long long *b, const int words);
+
+private:
+	int img_L;
+	int k;
+	int words;								// 64-bit words per glyph, padded to a multiple of 4
+	vector<unsigned long long> descriptors;	// words per sample, sample after sample
+	vector<int> labels;
+	void pack(Mat &glyph, unsigned long long *dst);
+};
+
+
+// Random Fourier features of the RBF kernel feeding a linear one-vs-rest model. It is trained
+// offline by distilling the probability output of the SVM (compress_ocr_model), the cost is
+// nnz(feature) * D + classes * D instead of one kernel evaluation per support vector.
+class RFFClassifier : public OCRClassifier
+{
+public:
+	RFFClassifier(OCR *_ocr);	// _ocr provides the chain-code feature
+	bool load(const char *filename);
+	bool save(const char *filename);
+	void fit(Mat &X, Mat &P, const double gamma, const int D, const double lambda = 1e-4, const unsigned long long seed = 0x5EED);
+	using OCRClassifier::predict;
+	void predict_top(Mat &glyph, const int k, vector<pair<int, double>> &top);
+	void predict_top(svm_node *fv, const int k, vector<pair<int, double>> &top);
+	int predict(svm_node *fv, double &prob);
+	const char* name() { return "RFF"; }
+	int get_map_dim();
+	static bool is_rff_file(const char *filename);
+
+private:
+	OCR *ocr;
+	int feature_dim;
+	int map_dim;
+	int class_num;
+	vector<float> W;	// feature_dim x map_dim, row i is the projection of feature i
+	vector<float> b;	// map_dim phases
+	vector<float> A;	// class_num x map_dim
+	vector<float> c;	// class_num biases
+};
+
+
 class OCR
 {
 public:
 	SpellingCorrector corrector;
 
-	OCR() {};
-	OCR(const char *svm_file_name, int _img_L, int _feature_L);
+	OCR() : fused_feature(false) {};
+	OCR(const char *model_file_name, int _img_L, int _feature_L);	// libsvm model, RFF model of compress_ocr_model or kNN glyphs of train_ocr_knn
 	~OCR() {};
+	OCR(const OCR&) = delete;				// the classifier keeps a pointer to its OCR
+	OCR& operator=(const OCR&) = delete;
 	double lbp_run(Mat &src, int thresh, double slope = 0);		// use LBP spacial histogram as feature vector
 	double chain_run(Mat &src, int thresh, double slope = 0);	// use chain code as feature
+	void chain_top_k(Mat &src, int thresh, const int k, vector<double> &top, double slope = 0);	// k best results of chain_run, best first
 	void feedback_verify(Text &text);
+	static bool is_word_gap(const double dist, const double median_dist);	// dist between two letters separates two words
 	void rotate_mat(Mat &src, Mat &dst, double rad, bool crop = false);
 	void geometric_normalization(Mat &src, Mat &dst, double rad, const bool crop);
-	void ARAN(Mat &src, Mat &dst, const int L = 24, const double para = 0.5);
+	static void ARAN(Mat &src, Mat &dst, const int L = 24, const double para = 0.5);
 	void extract_feature(Mat &src, svm_node *fv);
+	void extract_feature_fused(Mat &src, float *fv);	// dense version of extract_feature, traced and resampled in one pass
+	int dense_to_svm_node(const float *dense, svm_node *fv);
+	void set_fused_feature(bool fused);
 	int index_mapping(char c);
+	void chain_feature(Mat &src, svm_node *fv);	// extract_feature or extract_feature_fused, depends on set_fused_feature
+	void enable_cache(size_t capacity);
+	OCRCache* get_cache();
+	void set_classifier(shared_ptr<OCRClassifier> _classifier);
+	OCRClassifier* get_classifier();
+	int get_img_L();
+	int get_feature_dim();
 	
 
 private:
 	int img_L;
 	int feature_L;
-	svm_model *model;
-	flann::Index index;
-	Mat features;
-	vector<int> labels;
+	shared_ptr<OCRClassifier> classifier;
+	shared_ptr<OCRCache> cache;
+	bool fused_feature;
+
+	// combined GaussianBlur(7x7) + resize(img_L -> feature_L) weights, stored per source coordinate
+	vector<int> weight_begin;
+	vector<int> weight_end;
+	vector<float> weight;
+	void init_feature_weight();
 	void try_add_space(Text &text);
 	int chain_code_direction(Point p1, Point p2);
 };
@@ -0,0 +1,141 @@
+#ifndef __PROFILER__
+#define __PROFILER__
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <iostream>
+#include <fstream>
+
+using namespace std;
+
+
+// candidates counted at every stage of text_detect
+enum ProfileCounter
+{
+	COUNT_TREE_NODE,		// ERs of the component trees
+	COUNT_POOL,				// after non-maximum suppression
+	COUNT_STRONG,
+	COUNT_WEAK,
+	COUNT_TRACKED,			// strong ERs + weak ERs tracked from them
+	COUNT_GROUP,			// text lines of er_grouping
+	COUNT_CHARACTER,		// letters left in the lines after er_ocr
+	COUNT_NUM
+};
+
+
+// Profiler is a stopwatch with a log (Start/Stop/Log/Message/Report) for one thread, and the
+// process-wide tracing of the pipeline (the static functions). The tracing is off by default: a
+// ProfileSpan and add_count then only test one flag. When it is on, every thread records its spans
+// and counters into its own buffer, only the export functions lock them all.
+// Exports: write_chrome_trace() for chrome://tracing or Perfetto, a metrics line every period frames
+// (set_metrics_dump), and report_latency() with p50/p95/p99 of every span name.
+class Profiler
+{
+public:
+	Profiler();
+	void Start();
+	int Count();
+	double Stop();
+	void Log(std::string name);
+	void Message(std::string msg, float value);
+	void Report();
+
+	static void enable(bool on);
+	static inline bool is_enabled() { return enabled.load(memory_order_relaxed); }
+	static inline void add_count(ProfileCounter counter, long long n) { if (is_enabled()) record_count(counter, n); }
+	static void frame_end();
+	static void set_metrics_dump(const string &filename, int period);
+	static bool write_chrome_trace(const string &filename);
+	static void report_latency(ostream &out);
+	static void clear();
+
+	// the times vector of ERFilter::text_detect, summed over frame_num frames
+	static void print_stage_time(ostream &out, const vector<double> &total_time, int frame_num);
+
+	static long long now_us();
+	static void record_span(const char *name, int channel, long long begin, long long end);
+
+protected:
+	int count;
+	std::chrono::time_point<std::chrono::steady_clock> time;
+	struct record
+	{
+		record(std::string _name, long long _duration);
+		record(std::string _name, float _value, bool _is_msg);
+		std::string name;
+		long long duration;
+		float value;
+		bool is_msg;
+	};
+	std::queue<record> logs;
+
+private:
+	struct Event
+	{
+		const char *name;		// string literal, compared by content
+		int channel;			// -1 for the whole frame
+		long long begin;		// us since the process started
+		long long end;
+	};
+
+	struct ThreadBuffer
+	{
+		int tid;
+		mutex lock;				// only contended while exporting
+		vector<Event> events;
+		size_t dumped;			// events already in a metrics line
+		long long counter[COUNT_NUM];
+		unsigned long long dropped;
+	};
+
+	static const size_t MAX_EVENT = 1 << 20;		// per thread, later spans are counted as dropped
+
+	static atomic<bool> enabled;
+	static atomic<unsigned long long> frame_count;
+	static mutex registry_lock;
+	static vector<unique_ptr<ThreadBuffer>> buffers;		// never freed, a thread may exit before the export
+	static fstream metrics_out;
+	static int metrics_period;
+	static long long metrics_counter[COUNT_NUM];
+	static long long metrics_time;
+
+	static ThreadBuffer* thread_buffer();
+	static void record_count(ProfileCounter counter, long long n);
+	static void dump_metrics();
+};
+
+
+// Times a scope and records it as a span of the trace when the tracing is on. stop() ends the span
+// early and returns its seconds, so the caller can reuse the measurement.
+class ProfileSpan
+{
+public:
+	ProfileSpan(const char *_name, int _channel = -1) : name(_name), channel(_channel), begin(Profiler::now_us()), stopped(false) {}
+	~ProfileSpan() { stop(); }
+
+	double stop()
+	{
+		if (!stopped)
+		{
+			end = Profiler::now_us();
+			stopped = true;
+			if (Profiler::is_enabled())
+				Profiler::record_span(name, channel, begin, end);
+		}
+		return (end - begin) * 1e-6;
+	}
+
+private:
+	const char *name;
+	int channel;
+	long long begin;
+	long long end;
+	bool stopped;
+};
+
+#endif
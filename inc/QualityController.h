@@ -0,0 +1,73 @@
+#ifndef __QUALITY_CONTROLLER__
+#define __QUALITY_CONTROLLER__
+
+#include <vector>
+
+#include "ER.h"
+
+using namespace std;
+
+
+// Keeps the cost of text_detect under a per-frame latency target by trading quality for time.
+// There are two ladders of knobs: the detection ladder (THRESH_STEP, MIN_AREA, channel subset) and
+// the OCR ladder (OCR only on the N largest lines, down to no OCR). When the frames are over the
+// target, the ladder of the stage that dominates the measured cost goes one step down. A step is
+// only taken back, last taken first, after the cost has stayed under low_ratio * target for
+// hold_frames frames, so the controller does not oscillate around the target.
+class QualityController
+{
+public:
+	QualityController(ERFilter *_er_filter, double target_ms, int base_thresh_step, int base_min_area, double low_ratio = 0.6, int hold_frames = 15);
+
+	// times are the return value of the text_detect of the frame
+	void update(const vector<double> &times);
+	void reset();
+	void set_target(double target_ms);
+	int get_detect_level();
+	int get_ocr_level();
+	double get_cost();				// running mean ms per frame at the current levels
+	unsigned long long get_overrun_count();
+	unsigned long long get_change_count();
+
+private:
+	struct DetectLevel
+	{
+		int thresh_step;		// multiple of the base threshold step
+		int min_area;			// multiple of the base minimum area
+		int channel_mask;
+	};
+	static const DetectLevel DETECT_LADDER[];
+	static const int OCR_LADDER[];
+	static const int DETECT_LEVEL_NUM;
+	static const int OCR_LEVEL_NUM;
+
+	ERFilter *er_filter;
+
+	//! Parameters
+	double TARGET_MS;
+	int BASE_THRESH_STEP;
+	int BASE_MIN_AREA;
+	double LOW_RATIO;
+	int HOLD_FRAMES;
+	static const int MIN_DWELL = 3;		// frames at new levels before the running mean is trusted
+	static const double SPIKE_RATIO;	// a single frame this much over the target steps down at once
+	static const double ALPHA;
+
+	int detect_level;
+	int ocr_level;
+	vector<bool> history;				// the steps taken down, true for the OCR ladder
+	double cost_ema;
+	double ocr_ema;
+	int since_change;
+	int under_count;
+	int hold;							// frames under the low mark before a step up, starts at HOLD_FRAMES
+	bool last_step_up;
+	unsigned long long overrun_count;
+	unsigned long long change_count;
+
+	void step_down(bool ocr_dominates);
+	void step_up();
+	void apply();
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef __RESULT_SINK__
+#define __RESULT_SINK__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+
+#include <opencv.hpp>
+#include "TextRecognizer.h"
+#include "BoundedQueue.h"
+
+using namespace std;
+using namespace cv;
+
+
+// Result of one image or frame. It owns all of its data, so a sink can keep it after the ER trees of
+// the frame are freed. image is only filled when a sink needs_image(), then the producer must not
+// modify the pixels afterwards.
+struct ResultRecord
+{
+	string source;			// file name or frame
+	unsigned long long index;
+	vector<TextResult> text;
+	vector<double> times;	// same as ERFilter::text_detect, may be empty
+	Mat image;
+};
+
+
+// Destination of the results, none of them needs a display
+class ResultSink
+{
+public:
+	virtual ~ResultSink() {};
+	virtual void write(const ResultRecord &record) = 0;
+	virtual void flush() {};
+	virtual bool needs_image() { return false; }
+};
+
+
+// one JSON object per record and line:
+// {"source":"img_1","index":1,"time_ms":123.4,"text":[{"word":"EXIT","box":[x,y,w,h],"slope":0.01}]}
+class JsonLinesSink : public ResultSink
+{
+public:
+	JsonLinesSink(const string &filename);
+	void write(const ResultRecord &record);
+	void flush();
+	bool is_open();
+
+private:
+	fstream fout;
+	static void write_string(ostream &out, const string &s);
+};
+
+
+// one row per text line: source,index,word,x,y,width,height,slope
+class CsvSink : public ResultSink
+{
+public:
+	CsvSink(const string &filename);
+	void write(const ResultRecord &record);
+	void flush();
+	bool is_open();
+
+private:
+	fstream fout;
+	static void write_field(ostream &out, const string &s);
+};
+
+
+// Renders the boxes and words on its own thread, imshow when save_dir is empty, otherwise one jpg per
+// record in save_dir. Records are handed over through a short queue and dropped when the renderer
+// falls behind, so the processing never waits for the drawing.
+class VisualizationSink : public ResultSink
+{
+public:
+	VisualizationSink(const string &_window_name = "result", const string &_save_dir = "", size_t queue_capacity = 2);
+	~VisualizationSink();
+	void write(const ResultRecord &record);
+	bool needs_image() { return true; }
+	unsigned long long get_dropped();
+
+private:
+	string window_name;
+	string save_dir;
+	BoundedQueue<ResultRecord> queue;
+	thread renderer;
+	unsigned long long dropped;
+
+	void render();
+};
+
+#endif
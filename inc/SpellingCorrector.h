@@ -14,21 +14,52 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <memory>
 
+// Words are found through a symmetric delete index (SymSpell): every dictionary word is stored under
+// the hashes of its prefix with up to max_distance characters deleted, a query probes the hashes of
+// its own deletes and the candidates are verified by a bounded edit distance.
+// The index can be written by compile() and loaded back by memory mapping, without parsing the text.
 class SpellingCorrector
 {
 private:
-	typedef std::vector<std::string> Vector;
 	typedef std::map<std::string, int> Dictionary;
 
 	Dictionary dictionary;
+	int max_distance;
+	int index_distance;		// max_distance the index was built with
+	int prefix_length;
 
-	void edits(const std::string& word, Vector& edited_str);
-	void known(Vector& edited_str, Dictionary& candidates);
+	// index memory, built from the text or a mapped compiled dictionary, shared by copies of the corrector
+	struct Storage;
+	std::shared_ptr<Storage> storage;
+
+	// views of the index, word i is pool[word_offset[i]] ~ pool[word_offset[i+1]-1] (sorted) and appears counts[i] times
+	unsigned word_num;
+	const unsigned *word_offset;
+	const char *pool;
+	const int *counts;
+	unsigned key_num;
+	const unsigned long long *keys;		// distinct delete hashes
+	const unsigned *posting_offset;		// words of keys[i] are postings[posting_offset[i]] ~ postings[posting_offset[i+1]-1]
+	const unsigned *postings;
+	unsigned slot_num;
+	const unsigned *slots;				// open addressing table of index in keys + 1, 0 is empty
+
+	void build_index();
+	bool load_compiled(const std::string& filename);
+	void deletes(const char *word, int len, std::vector<unsigned long long>& hashes);
+	int find_key(unsigned long long hash);
+	static int bounded_distance(const char *a, int n, const char *b, int m, int max_d);
 
 public:
-	void load(const std::string& filename);
+	SpellingCorrector(int _max_distance = 2, int _prefix_length = 7);
+	bool load(const std::string& filename);		// text corpus or a dictionary written by compile()
+	bool compile(const std::string& filename);	// write the loaded words and their index in binary
 	std::string correct(const std::string& word);
+	void set_max_distance(int d);
+	unsigned size();
 };
 
 #endif
@@ -0,0 +1,84 @@
+#ifndef __TEXT_RECOGNIZER__
+#define __TEXT_RECOGNIZER__
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <opencv.hpp>
+#include "ER.h"
+#include "OCR.h"
+#include "adaboost.h"
+#include "SpellingCorrector.h"
+#include "Lexicon.h"
+
+using namespace std;
+using namespace cv;
+
+
+// A recognized text line. It owns no ER, so it stays valid after recognize() has returned.
+struct TextResult
+{
+	string word;
+	Rect box;
+	double slope;
+	vector<Rect> letter_box;
+	vector<double> letter_prob;
+};
+
+void make_text_result(const vector<Text> &text, vector<TextResult> &result);
+
+
+// Library entry point of the whole pipeline (ER extraction -> classification -> grouping -> OCR).
+// The models (cascades, OCR, transition table, dictionary, lexicon) are loaded once into a Model that
+// is never modified afterwards and is shared by every call. A call works on its own Context: a copy
+// of the ERFilter parameters and the ER buffers of one image, so any number of threads can call
+// recognize() on the same recognizer at the same time.
+// The load and set functions are not thread-safe, call them before the recognizer is shared.
+class TextRecognizer
+{
+public:
+	// per-call state, a thread that recognizes many images can keep one to reuse its buffers
+	struct Context
+	{
+		ERFilter er_filter;
+		ERs root;
+		vector<ERs> all;
+		vector<ERs> pool;
+		vector<ERs> strong;
+		vector<ERs> weak;
+		ERs tracked;
+		vector<Text> text;
+		vector<double> times;		// same as ERFilter::text_detect
+	};
+
+	TextRecognizer(int thresh_step = 8, int min_area = 120, int max_area = 900000, int stability_t = 2, double overlap_coef = 0.7, double min_ocr_prob = 0.15);
+	bool load_detector(const string &strong_file, const string &weak_file);
+	bool load_ocr(const string &model_file, const string &tp_file, int img_L, int feature_L);
+	bool load_dictionary(const string &filename);	// compiled by compile_dictionary() or a text corpus
+	bool load_lexicon(const string &filename);		// optional, compiled by compile_lexicon()
+	void set_ocr_top_k(int k);
+	void set_beam_width(int b);
+	void set_thread_num(int n);						// OpenMP threads inside one call, see ERFilter::set_thread_num
+	void set_pipeline(int features);				// PipelineFeature flags, without PIPELINE_OCR the words are empty
+	void enable_ocr_cache(size_t capacity);
+	bool is_ready();
+
+	vector<TextResult> recognize(const Mat &image) const;
+	vector<TextResult> recognize(const Mat &image, Context &context) const;
+
+private:
+	// immutable once loaded, the ERFilter modules point into the same Model
+	struct Model
+	{
+		ERFilter er_filter;
+		shared_ptr<CascadeBoost> stc;
+		shared_ptr<CascadeBoost> wtc;
+		shared_ptr<OCR> ocr;
+		shared_ptr<SpellingCorrector> corrector;
+		shared_ptr<Lexicon> lexicon;
+	};
+	shared_ptr<Model> model;
+};
+
+#endif
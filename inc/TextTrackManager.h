@@ -0,0 +1,66 @@
+#ifndef __TEXT_TRACK_MANAGER__
+#define __TEXT_TRACK_MANAGER__
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include <opencv.hpp>
+#include "ER.h"
+
+using namespace std;
+using namespace cv;
+
+
+// A text line followed across frames. The word is the one with the most accumulated OCR evidence,
+// confidence is its share of the evidence plus a prior of 1, so a single reading is never trusted.
+struct TextTrack
+{
+	int id;
+	Text text;					// box and slope of the last frame, word of the track, no ers
+	double confidence;
+	int missed;					// frames since the track was last seen
+	int since_ocr;				// frames since the last OCR of the track
+	int ocr_count;
+	Rect ocr_box;				// box at the last OCR
+	Mat appearance;				// downscaled grey patch of the last frame
+	unordered_map<string, double> votes;
+};
+
+
+// Associates the grouped text lines of every frame with persistent tracks by IoU and appearance, and
+// runs er_ocr only on the lines that need it: new tracks, tracks whose box moved or changed size
+// since their last OCR, tracks with low confidence, and every track once per refresh_interval frames.
+// The other lines take the word of their track, so stable text is not recognized again and does not flicker.
+class TextTrackManager
+{
+public:
+	TextTrackManager(double min_iou = 0.3, double min_similarity = 0.75, double min_confidence = 0.6, double box_change_iou = 0.7, int max_missed = 5, int refresh_interval = 30);
+
+	// text is the output of er_grouping and is replaced by the text of the tracks seen in this frame
+	void update(ERFilter *er_filter, ERs &all_er, vector<Mat> &channel, vector<Text> &text);
+	const vector<TextTrack>& get_tracks();
+	unsigned long long get_ocr_count();
+	unsigned long long get_skip_count();
+
+private:
+	//! Parameters
+	double MIN_IOU;
+	double MIN_SIMILARITY;		// 1 - mean absolute difference / 255 of the appearance patches
+	double MIN_CONFIDENCE;
+	double BOX_CHANGE_IOU;		// IoU with the box of the last OCR below which the track is recognized again
+	int MAX_MISSED;
+	int REFRESH_INTERVAL;
+
+	vector<TextTrack> tracks;
+	int next_id;
+	unsigned long long ocr_count;
+	unsigned long long skip_count;
+
+	static double iou(const Rect &a, const Rect &b);
+	static void make_appearance(Mat &gray, const Rect &box, Mat &appearance);
+	static double similarity(Mat &a, Mat &b);
+	void vote(TextTrack &track, Text &text);
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include <set>
 #include <algorithm>
 #include <math.h>
+#include <cstdint>
 
 #include <thread>
 #include <omp.h>
@@ -28,6 +29,14 @@ struct ColFea
 	double f;
 };
 
+// features of every dim bucketed into at most 256 bins, bin b holds the values in [value[b], value[b+1])
+struct BinnedData
+{
+	vector<vector<double>> value;		// lower bound of every bin, per dim
+	vector<vector<uint8_t>> bin;		// bin of every sample, per dim
+	vector<int> label;
+};
+
 struct FeatureVector
 {
 	FeatureVector() {}
@@ -139,6 +148,22 @@ public:
 		DECISION_STUMP
 	};
 
+protected:
+	// best threshold of one dim, Pr_p and Pw_n are the POS and NEG weight on the left (f < thresh)
+	struct StumpSplit
+	{
+		double loss;
+		double thresh;
+		double Pr_p;
+		double Pw_n;
+	};
+
+	static double stump_loss(int boost, double Pr_p, double Pw_n, double Pw_p, double Pr_n);
+	static double select_stump(int boost, const vector<StumpSplit> &split, double total_pos_weight, double total_neg_weight, double epsilon, int &dim, double &thresh, double &c_p, double &c_n);
+	static double search_stump(int boost, const vector<vector<ColFea>> &sorted_data, const vector<double> &weight, int &dim, double &thresh, double &c_p, double &c_n);
+	static double search_hist_stump(int boost, const BinnedData &binned, const vector<double> &weight, int &dim, double &thresh, double &c_p, double &c_n);
+	static void make_binned_data(const vector<vector<ColFea>> &sorted_data, int max_bin, BinnedData &binned);
+
 private:
 	int boost_type;
 	int base_type;
@@ -158,6 +183,7 @@ public:
 	CascadeBoost(string filename);
 	CascadeBoost(int boost, int base, double _Ftarget, double _f, double _d);
 	void set_num_iter(int _iter);
+	void set_max_bin(int n);
 	int get_num_iter();
 	double predict(vector<double> fv);
 	void train_classifier(TrainingData &td, string outfile);
@@ -173,14 +199,15 @@ private:
 	double Ftarget;
 	double f;
 	double d;
+	int max_bin;				// 0: search the sorted data, otherwise the histograms of at most max_bin bins (REAL and GENTLE)
 	vector<BaseClassifier*> classifier;
 	vector<int> num_of_iter;
 	vector<int> thresh;
 	vector<double> classifier_weight;
 	
 	void discrete_training(TrainingData &td, vector<set<double>> &thresh_set, vector<vector<ColFea>> &sorted_data, vector<double> &weight);
-	void real_training(TrainingData &td, vector<set<double>> &thresh_set, vector<vector<ColFea>> &sorted_data, vector<double> &weight);
-	void gentle_training(TrainingData &td, vector<set<double>> &thresh_set, vector<vector<ColFea>> &sorted_data, vector<double> &weight);
+	void real_training(TrainingData &td, vector<vector<ColFea>> &sorted_data, BinnedData &binned, vector<double> &weight);
+	void gentle_training(TrainingData &td, vector<vector<ColFea>> &sorted_data, BinnedData &binned, vector<double> &weight);
 };
 
 
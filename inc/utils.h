@@ -9,6 +9,12 @@
 #define MIN_OCR_PROBABILITY 0.15
 #define OCR_IMG_L 30
 #define OCR_FEATURE_L 15
+#define OCR_TEST_FOLD 5		// every 5th glyph of ocr_classifier/Other is held out of the kNN training
+#define OCR_CACHE_SIZE 4096
+#define OCR_CANDIDATE_NUM 3
+#define OCR_BEAM_WIDTH 8
+#define LIVE_TARGET_FPS 20
+#define LIVE_KEYFRAME_BUDGET 150	// ms of text_detect on a keyframe
 #define MAX_WIDTH 15000
 #define MAX_HEIGHT 8000
 
@@ -19,11 +25,17 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <random>
 
 #include <time.h>
 #include "ER.h"
 #include "OCR.h"
 #include "adaboost.h"
+#include "TextRecognizer.h"
+#include "Profiler.h"
+#include "GoldenOutput.h"
 
 
 using namespace std;
@@ -38,6 +50,7 @@ void load_video_thread(VideoCapture &cap, Mat frame, Mat result, static vector<T
 void show_result(Mat& src, Mat& result_img, vector<Text> &text, vector<double> &times = vector<double>(), ERs &tracked = ERs(),
 				vector<ERs> &strong = vector<ERs>(), vector<ERs> &weak = vector<ERs>(), vector<ERs> &all = vector<ERs>(), vector<ERs> &pool = vector<ERs>());
 void draw_FPS(Mat& src, double time);
+void set_show_option(bool draw_fps, bool save_image);
 
 
 // Testing Functions
@@ -46,6 +59,13 @@ void draw_multiple_channel(string img_name);
 void output_MSER_time(string img_name);
 void output_classifier_ROC(string classifier_name, string test_file);
 void output_optimal_path(string img_name);
+void compare_chain_feature();
+void compare_ocr_classifier();
+void report_ocr_compression();
+void benchmark_lattice_decode();
+void benchmark_recognizer_scaling();
+void compare_golden_config();
+void verify_lexicon();
 vector<Vec4i> load_gt(int n);
 Vec6d calc_detection_rate(int n, vector<Text> &text);	// Deprecated
 void calc_recall_rate();
@@ -59,40 +79,18 @@ void get_lbp_data();
 void bootstrap();
 void rotate_ocr_samples();
 void train_ocr_model();
+void train_ocr_knn();
+bool load_ocr_data(string filename, Mat &X, vector<int> &labels);
+void compress_ocr_model(const int D = 1024);
+void compile_dictionary();
+void compile_lexicon();
 void extract_ocr_sample();
 void train_classifier();
 void train_cascade();
 void opencv_train();
 
-// solve levenshtein distance(edit distance) by dynamic programming, 
-// check https://vinayakgarg.wordpress.com/2012/12/10/edit-distance-using-dynamic-programming/ for more info
-int levenshtein_distance(string str1, string str2);
-
-
-class Profiler
-{
-public:
-	Profiler();
-	void Start();
-	int Count();
-	double Stop();
-	void Log(std::string name);
-	void Message(std::string msg, float value);
-	void Report();
-
-protected:
-	int count;
-	std::chrono::time_point<std::chrono::steady_clock> time;
-	struct record
-	{
-		record(std::string _name, long long _duration);
-		record(std::string _name, float _value, bool _is_msg);
-		std::string name;
-		long long duration;
-		float value;
-		bool is_msg;
-	};
-	std::queue<record> logs;
-};
+// levenshtein distance(edit distance) by the bit-parallel algorithm of Myers and Hyyro,
+// a word of at most 64 letters is compared in one machine word per letter of the other
+int levenshtein_distance(const string &str1, const string &str2);
 
 #endif
\ No newline at end of file
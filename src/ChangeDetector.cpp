@@ -0,0 +1,242 @@
+#include "../inc/ChangeDetector.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define USE_SSE2_SAD
+#endif
+
+
+ChangeDetector::ChangeDetector(ERFilter *_er_filter, int tile_size, double change_t, int refresh_interval) : er_filter(_er_filter), TILE_SIZE(max(8, tile_size)), CHANGE_T(change_t),
+																											REFRESH_INTERVAL(max(1, refresh_interval)), since_refresh(0), need_refresh(true),
+																											processed_fraction(0), processed_sum(0), frame_count(0)
+{
+}
+
+
+void ChangeDetector::process(Mat &frame, vector<Text> &text)
+{
+	Mat gray;
+	cvtColor(frame, gray, COLOR_BGR2GRAY);
+	const Rect frame_rect(0, 0, gray.cols, gray.rows);
+
+	vector<Rect> regions;
+	const bool refresh = need_refresh || reference.size() != gray.size() || since_refresh + 1 >= REFRESH_INTERVAL;
+	if (refresh)
+	{
+		regions.push_back(frame_rect);
+		cache.clear();
+		reference = gray.clone();
+		since_refresh = 0;
+		need_refresh = false;
+	}
+	else
+	{
+		change_regions(gray, regions);
+		++since_refresh;
+	}
+
+	// grow the regions over the cached text they touch and merge the overlapping ones, until nothing changes
+	bool grown = true;
+	while (grown)
+	{
+		grown = false;
+		for (auto &r : regions)
+		{
+			for (auto &it : cache)
+			{
+				if ((r & it.box).area() > 0 && (r | it.box) != r)
+				{
+					r |= it.box;
+					grown = true;
+				}
+			}
+		}
+
+		for (int i = 0; i < regions.size() && !grown; i++)
+		{
+			for (int j = i + 1; j < regions.size(); j++)
+			{
+				if ((regions[i] & regions[j]).area() > 0)
+				{
+					regions[i] |= regions[j];
+					regions.erase(regions.begin() + j);
+					grown = true;
+					break;
+				}
+			}
+		}
+	}
+
+	// cached text outside every region is still valid, the rest is detected again
+	vector<Text> kept;
+	for (auto &it : cache)
+	{
+		bool touched = false;
+		for (auto &r : regions)
+			touched |= (r & it.box).area() > 0;
+		if (!touched)
+			kept.push_back(it);
+	}
+
+	double processed = 0;
+	for (auto &r : regions)
+	{
+		r &= frame_rect;
+		if (r.area() == 0)
+			continue;
+
+		detect_region(frame, r, kept);
+		if (!refresh)
+		{
+			Mat reference_roi = reference(r);
+			gray(r).copyTo(reference_roi);
+		}
+		processed += r.area();
+	}
+
+	cache = kept;
+	text = cache;
+
+	processed_fraction = processed / frame_rect.area();
+	processed_sum += processed_fraction;
+	++frame_count;
+}
+
+
+void ChangeDetector::force_refresh()
+{
+	need_refresh = true;
+}
+
+
+double ChangeDetector::get_processed_fraction()
+{
+	return processed_fraction;
+}
+
+
+double ChangeDetector::get_mean_processed_fraction()
+{
+	return frame_count ? processed_sum / frame_count : 0;
+}
+
+
+unsigned ChangeDetector::tile_sad(const uchar *a, const uchar *b, const int step_a, const int step_b, const int width, const int height)
+{
+	unsigned sad = 0;
+#ifdef USE_SSE2_SAD
+	__m128i acc = _mm_setzero_si128();
+#endif
+	for (int y = 0; y < height; y++, a += step_a, b += step_b)
+	{
+		int x = 0;
+#ifdef USE_SSE2_SAD
+		// psadbw sums the absolute differences of 8 bytes into each 64-bit lane
+		for (; x + 16 <= width; x += 16)
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + x)), _mm_loadu_si128((const __m128i*)(b + x))));
+#endif
+		for (; x < width; x++)
+			sad += abs(a[x] - b[x]);
+	}
+#ifdef USE_SSE2_SAD
+	sad += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+	return sad;
+}
+
+
+// changed tiles, dilated by one tile, grouped by 8-connectivity into bounding rectangles
+void ChangeDetector::change_regions(Mat &gray, vector<Rect> &regions)
+{
+	const int tiles_x = (gray.cols + TILE_SIZE - 1) / TILE_SIZE;
+	const int tiles_y = (gray.rows + TILE_SIZE - 1) / TILE_SIZE;
+	vector<uchar> changed(tiles_x * tiles_y, 0);
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			const int x = tx * TILE_SIZE;
+			const int y = ty * TILE_SIZE;
+			const int w = min(TILE_SIZE, gray.cols - x);
+			const int h = min(TILE_SIZE, gray.rows - y);
+			const unsigned sad = tile_sad(gray.ptr<uchar>(y, x), reference.ptr<uchar>(y, x), gray.step, reference.step, w, h);
+			changed[ty * tiles_x + tx] = sad > CHANGE_T * w * h;
+		}
+	}
+
+	vector<uchar> dilated(tiles_x * tiles_y, 0);
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			if (!changed[ty * tiles_x + tx])
+				continue;
+			for (int y = max(0, ty - 1); y <= min(tiles_y - 1, ty + 1); y++)
+				for (int x = max(0, tx - 1); x <= min(tiles_x - 1, tx + 1); x++)
+					dilated[y * tiles_x + x] = 1;
+		}
+	}
+
+	const Rect frame_rect(0, 0, gray.cols, gray.rows);
+	vector<int> stack;
+	for (int t = 0; t < dilated.size(); t++)
+	{
+		if (dilated[t] != 1)
+			continue;
+
+		int x1 = t % tiles_x, x2 = x1;
+		int y1 = t / tiles_x, y2 = y1;
+		dilated[t] = 2;
+		stack.push_back(t);
+		while (!stack.empty())
+		{
+			const int cur = stack.back();
+			stack.pop_back();
+			const int cx = cur % tiles_x;
+			const int cy = cur / tiles_x;
+			x1 = min(x1, cx);
+			x2 = max(x2, cx);
+			y1 = min(y1, cy);
+			y2 = max(y2, cy);
+
+			for (int y = max(0, cy - 1); y <= min(tiles_y - 1, cy + 1); y++)
+			{
+				for (int x = max(0, cx - 1); x <= min(tiles_x - 1, cx + 1); x++)
+				{
+					if (dilated[y * tiles_x + x] == 1)
+					{
+						dilated[y * tiles_x + x] = 2;
+						stack.push_back(y * tiles_x + x);
+					}
+				}
+			}
+		}
+
+		regions.push_back(Rect(x1 * TILE_SIZE, y1 * TILE_SIZE, (x2 - x1 + 1) * TILE_SIZE, (y2 - y1 + 1) * TILE_SIZE) & frame_rect);
+	}
+}
+
+
+// text_detect on one region, the boxes are moved to frame coordinates and the ER trees are freed
+void ChangeDetector::detect_region(Mat &frame, const Rect &region, vector<Text> &text)
+{
+	ERs root;
+	vector<ERs> all;
+	vector<ERs> pool;
+	vector<ERs> strong;
+	vector<ERs> weak;
+	ERs tracked;
+	vector<Text> found;
+	er_filter->text_detect(frame(region), root, all, pool, strong, weak, tracked, found);
+
+	for (auto &it : found)
+	{
+		it.ers.clear();
+		it.box.x += region.x;
+		it.box.y += region.y;
+		text.push_back(it);
+	}
+
+	for (auto it : root)
+		er_filter->er_delete(it);
+}
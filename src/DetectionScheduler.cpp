@@ -0,0 +1,201 @@
+#include "../inc/DetectionScheduler.h"
+
+
+DetectionScheduler::DetectionScheduler(ERFilter *_er_filter, double target_fps, int max_interval) : er_filter(_er_filter), TARGET_FPS(target_fps), MAX_INTERVAL(max(1, max_interval)),
+																								MIN_MATCH_SCORE(0.6), MAX_DRIFT(2.0), SCENE_CHANGE_T(12),
+																								interval(1), since_keyframe(0), need_keyframe(true),
+																								detect_time(0), track_time(0), keyframe_count(0), tracked_count(0)
+{
+}
+
+
+bool DetectionScheduler::process(Mat &frame, vector<Text> &text)
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	Mat gray;
+	cvtColor(frame, gray, COLOR_BGR2GRAY);
+	Mat thumb;
+	resize(gray, thumb, Size(max(1, gray.cols / THUMB_SCALE), max(1, gray.rows / THUMB_SCALE)), 0, 0, INTER_AREA);
+
+	bool keyframe = need_keyframe || key_thumb.empty() || since_keyframe + 1 >= interval || scene_changed(thumb);
+	if (!keyframe && !track(gray, text))
+		keyframe = true;
+
+	const double alpha = 0.1;
+	if (keyframe)
+	{
+		detect(frame, gray, text);
+		key_thumb = thumb;
+		since_keyframe = 0;
+		need_keyframe = false;
+
+		const double t = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		detect_time = (keyframe_count == 0) ? t : (1 - alpha) * detect_time + alpha * t;
+		++keyframe_count;
+	}
+	else
+	{
+		++since_keyframe;
+
+		const double t = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		track_time = (tracked_count == 0) ? t : (1 - alpha) * track_time + alpha * t;
+		++tracked_count;
+	}
+
+	update_interval();
+	return keyframe;
+}
+
+
+void DetectionScheduler::force_keyframe()
+{
+	need_keyframe = true;
+}
+
+
+void DetectionScheduler::set_target_fps(double fps)
+{
+	TARGET_FPS = fps;
+	update_interval();
+}
+
+
+void DetectionScheduler::set_track_param(double min_score, double max_drift, double scene_change_t)
+{
+	MIN_MATCH_SCORE = min_score;
+	MAX_DRIFT = max_drift;
+	SCENE_CHANGE_T = scene_change_t;
+}
+
+
+int DetectionScheduler::get_interval()
+{
+	return interval;
+}
+
+
+unsigned long long DetectionScheduler::get_keyframe_count()
+{
+	return keyframe_count;
+}
+
+
+unsigned long long DetectionScheduler::get_tracked_count()
+{
+	return tracked_count;
+}
+
+
+double DetectionScheduler::get_detect_time()
+{
+	return detect_time;
+}
+
+
+const vector<double>& DetectionScheduler::get_detect_times()
+{
+	return detect_times;
+}
+
+
+double DetectionScheduler::get_track_time()
+{
+	return track_time;
+}
+
+
+// full detection, the ER trees are freed here so the returned text and the tracks keep no ER
+void DetectionScheduler::detect(Mat &frame, Mat &gray, vector<Text> &text)
+{
+	ERs root;
+	vector<ERs> all;
+	vector<ERs> pool;
+	vector<ERs> strong;
+	vector<ERs> weak;
+	ERs tracked;
+	text.clear();
+	detect_times = er_filter->text_detect(frame, root, all, pool, strong, weak, tracked, text);
+
+	tracks.clear();
+	const Rect frame_rect(0, 0, gray.cols, gray.rows);
+	for (auto &it : text)
+	{
+		it.ers.clear();
+
+		const Rect box = it.box & frame_rect;
+		if (box.width < 4 || box.height < 4)
+			continue;
+
+		Track track;
+		track.text = it;
+		track.key_box = box;
+		track.patch = gray(box).clone();
+		tracks.push_back(track);
+	}
+
+	for (auto it : root)
+		er_filter->er_delete(it);
+}
+
+
+// search every keyframe patch in a window of one box height around its last position
+bool DetectionScheduler::track(Mat &gray, vector<Text> &text)
+{
+	const Rect frame_rect(0, 0, gray.cols, gray.rows);
+	for (auto &it : tracks)
+	{
+		const Rect &box = it.text.box;
+		const int margin = max(8, box.height);
+		const Rect window = Rect(box.x - margin, box.y - margin, box.width + 2 * margin, box.height + 2 * margin) & frame_rect;
+		if (window.width < it.patch.cols || window.height < it.patch.rows)
+			return false;
+
+		Mat score;
+		matchTemplate(gray(window), it.patch, score, TM_CCOEFF_NORMED);
+		double max_score;
+		Point max_loc;
+		minMaxLoc(score, nullptr, &max_score, nullptr, &max_loc);
+		if (max_score < MIN_MATCH_SCORE)
+			return false;
+
+		const Rect new_box(window.x + max_loc.x, window.y + max_loc.y, it.patch.cols, it.patch.rows);
+		const double dx = new_box.x - it.key_box.x;
+		const double dy = new_box.y - it.key_box.y;
+		if (sqrt(dx * dx + dy * dy) > MAX_DRIFT * it.key_box.height)
+			return false;
+
+		it.text.box = new_box;
+	}
+
+	text.clear();
+	for (auto &it : tracks)
+		text.push_back(it.text);
+
+	return true;
+}
+
+
+bool DetectionScheduler::scene_changed(Mat &thumb)
+{
+	if (thumb.size() != key_thumb.size())
+		return true;
+
+	Mat diff;
+	absdiff(thumb, key_thumb, diff);
+	return mean(diff)[0] > SCENE_CHANGE_T;
+}
+
+
+// mean cost per frame over a cycle of n frames is (detect + (n - 1) * track) / n,
+// n is the smallest interval that brings it under the frame budget
+void DetectionScheduler::update_interval()
+{
+	const double budget = 1.0 / TARGET_FPS;
+	if (keyframe_count == 0 || detect_time <= budget)
+		interval = 1;
+	else if (track_time >= budget)
+		interval = MAX_INTERVAL;
+	else
+		interval = min(MAX_INTERVAL, max(1, (int)ceil((detect_time - track_time) / (budget - track_time))));
+}
@@ -13,8 +13,13 @@ ER::ER(const int level_, const int pixel_, const int x_, const int y_) : level(l
 // ===================== ER_filter ====================
 // ====================================================
 ERFilter::ERFilter(int thresh_step, int min_area, int max_area, int stability_t, double overlap_coef, double min_ocr_prob) : THRESH_STEP(thresh_step), MIN_AREA(min_area), MAX_AREA(max_area),
-																													STABILITY_T(stability_t), OVERLAP_COEF(overlap_coef), MIN_OCR_PROB(min_ocr_prob)
+																													STABILITY_T(stability_t), OVERLAP_COEF(overlap_coef), MIN_OCR_PROB(min_ocr_prob),
+																													OCR_TOP_K(1), BEAM_WIDTH(8), LEX_MAX_EDIT(1), LEX_WEIGHT(30), THREAD_NUM(0),
+																													CHANNEL_MASK(0x3F), OCR_MAX_LINE(-1), PIPELINE(PIPELINE_OCR)
 {
+	corrector = nullptr;
+	lexicon = nullptr;
+	group_output = nullptr;
 
 }
 
@@ -30,10 +35,105 @@ void ERFilter::set_min_area(int m)
 }
 
 
+// k > 1 keeps the k best OCR letters of every ER and decodes the line by beam search
+void ERFilter::set_ocr_top_k(int k)
+{
+	OCR_TOP_K = max(1, k);
+}
+
+
+void ERFilter::set_beam_width(int b)
+{
+	BEAM_WIDTH = max(1, b);
+}
+
+
+// a hypothesis pays weight for every edit away from the lexicon, and is pruned when no word
+// is within max_edit edits (more than 1 is considerably slower)
+void ERFilter::set_lexicon_param(int max_edit, double weight)
+{
+	LEX_MAX_EDIT = max(0, max_edit);
+	LEX_WEIGHT = weight;
+}
+
+
+// callers that already run many images in parallel set 1, so every image stays on its own thread
+void ERFilter::set_thread_num(int n)
+{
+	THREAD_NUM = max(0, n);
+}
+
+
+// channels whose bit is not set get no ER tree, their root is nullptr and their ER lists are empty
+void ERFilter::set_channel_mask(int mask)
+{
+	CHANNEL_MASK = mask & 0x3F;
+}
+
+
+// lines beyond the n largest keep their box and get no word, 0 turns the OCR off
+void ERFilter::set_ocr_max_line(int n)
+{
+	OCR_MAX_LINE = max(-1, n);
+}
+
+
+// PipelineFeature flags, PIPELINE_OCR by default
+void ERFilter::set_pipeline(int features)
+{
+	PIPELINE = features & (PIPELINE_OCR | PIPELINE_STROKE_WIDTH | PIPELINE_ALL_ER);
+}
+
+
+int ERFilter::get_pipeline()
+{
+	return PIPELINE;
+}
+
+
+const vector<double>& ERFilter::get_decode_time()
+{
+	return decode_time;
+}
+
+
+// text_detect copies its lines to out right after er_grouping, nullptr to stop
+void ERFilter::set_group_output(vector<Text> *out)
+{
+	group_output = out;
+}
+
+
+// calls fn with the Pipeline of the current features, the only runtime branch on them
+template <class Fn>
+void ERFilter::dispatch(Fn fn)
+{
+	switch (PIPELINE)
+	{
+	case 0: fn(Pipeline<0>()); break;
+	case 1: fn(Pipeline<1>()); break;
+	case 2: fn(Pipeline<2>()); break;
+	case 3: fn(Pipeline<3>()); break;
+	case 4: fn(Pipeline<4>()); break;
+	case 5: fn(Pipeline<5>()); break;
+	case 6: fn(Pipeline<6>()); break;
+	case 7: fn(Pipeline<7>()); break;
+	}
+}
+
+
 vector<double> ERFilter::text_detect(Mat src, ERs &root, vector<ERs> &all, vector<ERs> &pool, vector<ERs> &strong, vector<ERs> &weak, ERs &tracked, vector<Text> &text)
 {
-	chrono::high_resolution_clock::time_point start, end;
-	start = chrono::high_resolution_clock::now();
+	vector<double> times;
+	dispatch([&](auto p) { times = text_detect_impl<decltype(p)>(src, root, all, pool, strong, weak, tracked, text); });
+	return times;
+}
+
+
+template <class P>
+vector<double> ERFilter::text_detect_impl(Mat &src, ERs &root, vector<ERs> &all, vector<ERs> &pool, vector<ERs> &strong, vector<ERs> &weak, ERs &tracked, vector<Text> &text)
+{
+	ProfileSpan total_span("text_detect");
 
 	Mat Ycrcb;
 	vector<Mat> channel;
@@ -45,68 +145,76 @@ vector<double> ERFilter::text_detect(Mat src, ERs &root, vector<ERs> &all, vecto
 	strong.resize(channel.size());
 	weak.resize(channel.size());
 
-	vector<chrono::high_resolution_clock::time_point> time_vec(channel.size() * 4 + 4);
+	// seconds of extraction, NMS and classification of every channel
+	vector<Vec3d> channel_time(channel.size());
 
-#pragma omp parallel for
+	ProfileSpan channel_span("channels");
+#pragma omp parallel for num_threads(THREAD_NUM > 0 ? THREAD_NUM : omp_get_max_threads())
 	for (int i = 0; i < channel.size(); i++)
 	{
-		time_vec[i*4] = chrono::high_resolution_clock::now();
+		if (!(CHANNEL_MASK & (1 << i)))
+		{
+			root[i] = nullptr;
+			all[i].clear();
+			pool[i].clear();
+			strong[i].clear();
+			weak[i].clear();
+			continue;
+		}
+
+		ProfileSpan extract_span("extract", i);
 		root[i] = er_tree_extract(channel[i]);
-		time_vec[i*4+1] = chrono::high_resolution_clock::now();
-		non_maximum_supression(root[i], all[i], pool[i], channel[i]);
-		time_vec[i*4+2] = chrono::high_resolution_clock::now();
-		classify(pool[i], strong[i], weak[i], channel[i]);
-		time_vec[i*4+3] = chrono::high_resolution_clock::now();
-	}
+		channel_time[i][0] = extract_span.stop();
 
-	time_vec.rbegin()[3] = chrono::high_resolution_clock::now();
-	er_track(strong, weak, tracked, channel, Ycrcb);
-	time_vec.rbegin()[2] = chrono::high_resolution_clock::now();
-#ifndef DO_OCR
-	er_grouping(tracked, text, false, false);
-	time_vec.rbegin()[1] = chrono::high_resolution_clock::now();
-#else
-	er_grouping(tracked, text, false, true);
-	time_vec.rbegin()[1] = chrono::high_resolution_clock::now();
-	er_ocr(tracked, channel, text);
-	time_vec.rbegin()[0] = chrono::high_resolution_clock::now();
-#endif
-
-	end = chrono::high_resolution_clock::now();
-
-
-	// calculate time
-	chrono::duration<double> extract_time;
-	chrono::duration<double> nms_time;
-	chrono::duration<double> classify_time;
-	for (int i = 0; i < channel.size(); i++)
-	{
-		if(extract_time < time_vec[i * 4 + 1] - time_vec[i * 4])
-			extract_time = time_vec[i * 4 + 1] - time_vec[i * 4];
+		ProfileSpan nms_span("nms", i);
+		non_maximum_supression_impl<P>(root[i], all[i], pool[i], channel[i]);
+		channel_time[i][1] = nms_span.stop();
 
-		if(nms_time < time_vec[i * 4 + 2] - time_vec[i * 4 + 1])
-			nms_time = time_vec[i * 4 + 2] - time_vec[i * 4 + 1];
+		ProfileSpan classify_span("classify", i);
+		classify(pool[i], strong[i], weak[i], channel[i]);
+		channel_time[i][2] = classify_span.stop();
 
-		if(classify_time < time_vec[i * 4 + 3] - time_vec[i * 4 + 2])
-			classify_time = time_vec[i * 4 + 3] - time_vec[i * 4 + 2];
+		Profiler::add_count(COUNT_POOL, pool[i].size());
+		Profiler::add_count(COUNT_STRONG, strong[i].size());
+		Profiler::add_count(COUNT_WEAK, weak[i].size());
+	}
+	channel_span.stop();
+
+	ProfileSpan track_span("track");
+	er_track_impl<P>(strong, weak, tracked, channel, Ycrcb);
+	const double track_time = track_span.stop();
+	Profiler::add_count(COUNT_TRACKED, tracked.size());
+
+	ProfileSpan grouping_span("grouping");
+	er_grouping_impl<P>(tracked, text, false, P::ocr);
+	const double grouping_time = grouping_span.stop();
+	Profiler::add_count(COUNT_GROUP, text.size());
+	if (group_output != nullptr)
+		*group_output = text;
+
+	double ocr_time = 0;
+	if (P::ocr)
+	{
+		ProfileSpan ocr_span("ocr");
+		er_ocr(tracked, channel, text);
+		ocr_time = ocr_span.stop();
+		for (auto &it : text)
+			Profiler::add_count(COUNT_CHARACTER, it.ers.size());
 	}
-	chrono::duration<double> track_time = (time_vec.rbegin()[2] - time_vec.rbegin()[3]);
-	chrono::duration<double> grouping_time = (time_vec.rbegin()[1] - time_vec.rbegin()[2]);
-#ifdef DO_OCR
-	chrono::duration<double> ocr_time = (time_vec.rbegin()[0] - time_vec.rbegin()[1]);
-#endif
 
+	// the channels run in parallel, a stage takes as long as its slowest channel
 	vector<double> times(7, 0);
-	times[0] = extract_time.count();
-	times[1] = nms_time.count();
-	times[2] = classify_time.count();
-	times[3] = track_time.count();
-	times[4] = grouping_time.count();
-#ifdef DO_OCR
-	times[5] = ocr_time.count();
-#endif
-	times[6] = chrono::duration<double>(end - start).count();
+	for (int i = 0; i < channel.size(); i++)
+	{
+		for (int k = 0; k < 3; k++)
+			times[k] = max(times[k], channel_time[i][k]);
+	}
+	times[3] = track_time;
+	times[4] = grouping_time;
+	times[5] = ocr_time;
+	times[6] = total_span.stop();
 
+	Profiler::frame_end();
 	return times;
 }
 
@@ -414,6 +522,13 @@ void ERFilter::process_stack(const int new_pixel_grey_level, ERs &er_stack)
 
 
 void ERFilter::non_maximum_supression(ER *er, ERs &all, ERs &pool, Mat input)
+{
+	dispatch([&](auto p) { non_maximum_supression_impl<decltype(p)>(er, all, pool, input); });
+}
+
+
+template <class P>
+void ERFilter::non_maximum_supression_impl(ER *er, ERs &all, ERs &pool, Mat &input)
 {
 	// Non Recursive Preorder Tree Traversal
 	// See http://algorithms.tutorialhorizon.com/binary-tree-preorder-traversal-non-recursive-approach/ for more info.
@@ -422,15 +537,16 @@ void ERFilter::non_maximum_supression(ER *er, ERs &all, ERs &pool, Mat input)
 	vector<ER *> tree_stack;
 	ER *root = er;
 	root->parent = root;
+	long long node_count = 0;
 
 save_step_2:
 	// 2. Print the root and push it to Stack and go left, i.e root=root.left and till it hits the nullptr.
 	for (; root != nullptr; root = root->child)
 	{
 		tree_stack.push_back(root);
-	#ifdef GET_ALL_ER
-		all.push_back(root);
-	#endif
+		if (P::all_er)
+			all.push_back(root);
+		++node_count;
 	}
 	
 
@@ -438,6 +554,7 @@ save_step_2:
 	//		return, we are done.
 	if (root == nullptr && tree_stack.empty())
 	{
+		Profiler::add_count(COUNT_TREE_NODE, node_count);
 		//cout << "Before NMS: " << n << "    After NMS: " << pool.size() << endl;
 		return;
 	}
@@ -558,17 +675,21 @@ void ERFilter::classify(ERs &pool, ERs &strong, ERs &weak, Mat input)
 
 void ERFilter::er_track(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vector<Mat> &channel, Mat Ycrcb)
 {
-#ifdef USE_STROKE_WIDTH
+	dispatch([&](auto p) { er_track_impl<decltype(p)>(strong, weak, all_er, channel, Ycrcb); });
+}
+
+
+template <class P>
+void ERFilter::er_track_impl(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vector<Mat> &channel, Mat &Ycrcb)
+{
 	StrokeWidth SWT;
-#endif
 	for (int i = 0; i < strong.size(); i++)
 	{
 		for (auto it : strong[i])
 		{
 			calc_color(it, channel[i], Ycrcb);
-#ifdef USE_STROKE_WIDTH
-			it->stkw = SWT.SWT(channel[i](it->bound));
-#endif
+			if (P::stroke_width)
+				it->stkw = SWT.SWT(channel[i](it->bound));
 			it->center = Point(it->bound.x + it->bound.width / 2, it->bound.y + it->bound.height / 2);
 			it->ch = i;
 		}
@@ -576,9 +697,8 @@ void ERFilter::er_track(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vec
 		for (auto it : weak[i])
 		{
 			calc_color(it, channel[i], Ycrcb);
-#ifdef USE_STROKE_WIDTH
-			it->stkw = SWT.SWT(channel[i](it->bound));
-#endif
+			if (P::stroke_width)
+				it->stkw = SWT.SWT(channel[i](it->bound));
 			it->center = Point(it->bound.x + it->bound.width / 2, it->bound.y + it->bound.height / 2);
 			it->ch = i;
 		}
@@ -612,10 +732,7 @@ void ERFilter::er_track(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vec
 					abs(s->color1 - w->color1) < 25 &&
 					abs(s->color2 - w->color2) < 25 &&
 					abs(s->color3 - w->color3) < 25 &&
-#ifdef USE_STROKE_WIDTH
-					(s->stkw / w->stkw) < 4 &&
-					(s->stkw / w->stkw) > 0.25 &&
-#endif
+					(!P::stroke_width || ((s->stkw / w->stkw) < 4 && (s->stkw / w->stkw) > 0.25)) &&
 					abs(s->area - w->area) < min(s->area, w->area) * 3)
 				{
 					tracked[m][n] = true;
@@ -637,6 +754,13 @@ void ERFilter::er_track(vector<ERs> &strong, vector<ERs> &weak, ERs &all_er, vec
 
 
 void ERFilter::er_grouping(ERs &all_er, vector<Text> &text, bool overlap_sup, bool inner_sup)
+{
+	dispatch([&](auto p) { er_grouping_impl<decltype(p)>(all_er, text, overlap_sup, inner_sup); });
+}
+
+
+template <class P>
+void ERFilter::er_grouping_impl(ERs &all_er, vector<Text> &text, bool overlap_sup, bool inner_sup)
 {
 	sort(all_er.begin(), all_er.end(), [](ER *a, ER *b) { return a->center.x < b->center.x; });
 	
@@ -660,10 +784,7 @@ void ERFilter::er_grouping(ERs &all_er, vector<Text> &text, bool overlap_sup, bo
 				abs(a->color1 - b->color1) < 25 &&
 				abs(a->color2 - b->color2) < 25 &&
 				abs(a->color3 - b->color3) < 25 &&
-#ifdef USE_STROKE_WIDTH
-				(a->stkw / b->stkw) < 4 &&
-				(a->stkw / b->stkw) > 0.25 &&
-#endif
+				(!P::stroke_width || ((a->stkw / b->stkw) < 4 && (a->stkw / b->stkw) > 0.25)) &&
 				abs(a->area - b->area) < min(a->area, b->area)*4)
 			{
 				if (group_index[i] == -1 && group_index[j] == -1)
@@ -708,13 +829,13 @@ void ERFilter::er_grouping(ERs &all_er, vector<Text> &text, bool overlap_sup, bo
 
 		text[i].slope = fitline_avgslope(points);
 		//cout << text[i].slope << endl;
-#ifndef DO_OCR
+
+		// er_ocr narrows it down to the recognized letters
 		text[i].box = text[i].ers.front()->bound;
 		for (int j = 0; j < text[i].ers.size(); j++)
 		{
 			text[i].box |= text[i].ers[j]->bound;
 		}
-#endif	
 	}
 }
 
@@ -723,6 +844,18 @@ void ERFilter::er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text)
 {
 	const unsigned min_er = 6;
 	const unsigned min_pass_ocr = 2;
+	Graph graph;
+	vector<vector<double>> candidates;
+	decode_time.clear();
+
+	// the largest lines are the most legible ones, the others are left without a word
+	vector<Text> skipped;
+	if (OCR_MAX_LINE >= 0 && text.size() > OCR_MAX_LINE)
+	{
+		sort(text.begin(), text.end(), [](const Text &a, const Text &b) { return a.box.area() > b.box.area(); });
+		skipped.assign(text.begin() + OCR_MAX_LINE, text.end());
+		text.resize(OCR_MAX_LINE);
+	}
 	
 	for (int i = text.size()-1; i >= 0; i--)
 	{
@@ -751,12 +884,19 @@ void ERFilter::er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text)
 		}
 
 
-		// get OCR label of each ER
-	#pragma omp parallel for
+		// rotate the whole line upright once, characters are then cut from the rectified strip
+		vector<Mat> strip;
+		vector<Rect> glyph_rect;
+		deskew_line(text[i], channel, strip, glyph_rect);
+
+		// get OCR label of each ER, candidates[j] are the OCR_TOP_K best results of text[i].ers[j]
+		candidates.resize(text[i].ers.size());
+	#pragma omp parallel for num_threads(THREAD_NUM > 0 ? THREAD_NUM : omp_get_max_threads())
 		for (int j = 0; j < text[i].ers.size(); j++)
 		{
 			ER* er = text[i].ers[j];
-			const double result = ocr->chain_run(channel[er->ch](er->bound), er->level*THRESH_STEP, text[i].slope);
+			ocr->chain_top_k(strip[er->ch](glyph_rect[j]), er->level*THRESH_STEP, OCR_TOP_K, candidates[j]);
+			const double result = candidates[j].front();
 			er->letter = floor(result);
 			er->prob = result - floor(result);
 		}
@@ -765,7 +905,10 @@ void ERFilter::er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text)
 		for (int j = text[i].ers.size() - 1; j >= 0; j--)
 		{
 			if (text[i].ers[j]->prob < MIN_OCR_PROB)
+			{
 				text[i].ers.erase(text[i].ers.begin() + j);
+				candidates.erase(candidates.begin() + j);
+			}
 		}
 		
 		if (text[i].ers.size() < min_pass_ocr)
@@ -774,25 +917,29 @@ void ERFilter::er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text)
 			continue;
 		}
 
-		Graph graph;
 		build_graph(text[i], graph);
-		solve_graph(text[i], graph);
+		chrono::high_resolution_clock::time_point decode_start = chrono::high_resolution_clock::now();
+		if (OCR_TOP_K > 1 || lexicon != nullptr)
+			beam_search(text[i], graph, candidates);
+		else
+			solve_graph(text[i], graph);
+		decode_time.push_back(chrono::duration<double>(chrono::high_resolution_clock::now() - decode_start).count());
 		ocr->feedback_verify(text[i]);
 
 		/*fstream fout("graph.txt", fstream::out);
 		for (int i = 0; i < graph.size(); i++)
 		{
-			fout << graph[i].index << " " << graph[i].vertex->letter << " " << graph[i].vertex->prob * 100 << " ";
-			for (int j = 0; j < graph[i].adj_list.size(); j++)
+			fout << i << " " << graph.vertex[i]->letter << " " << graph.vertex[i]->prob * 100 << " ";
+			for (int e = graph.offset[i]; e < graph.offset[i + 1]; e++)
 			{
-				fout << graph[i].adj_list[j].index << " ";
-				fout << graph[i].edge_prob[j] * 50 << " ";
+				fout << graph.adj[e] << " ";
+				fout << graph.edge_prob[e] * 50 << " ";
 			}
 			fout << endl;
 
 			char buf[30];
 			sprintf(buf, "D:/%d.PNG", i);
-			Mat ocr_img = channel[graph[i].vertex->ch](graph[i].vertex->bound);
+			Mat ocr_img = channel[graph.vertex[i]->ch](graph.vertex[i]->bound);
 			double resize_factor = 30.0 / ocr_img.rows;
 			resize(ocr_img, ocr_img, Size(), resize_factor, resize_factor);
 			threshold(ocr_img, ocr_img, 128, 255, THRESH_OTSU);
@@ -810,6 +957,78 @@ void ERFilter::er_ocr(ERs &all_er, vector<Mat> &channel, vector<Text> &text)
 		spell_check(text[i]);
 		//cout << text[i].word << " " << text[i].slope << endl;
 	}
+
+	text.insert(text.end(), skipped.begin(), skipped.end());
+}
+
+
+// Rectify the region of a text line with one affine warp per used channel.
+// strip[ch] is the upright line of channel ch and glyph_rect[j] the box of text.ers[j] in it.
+// Lines that are already horizontal are not warped, strip is the channel itself.
+void ERFilter::deskew_line(Text &text, vector<Mat> &channel, vector<Mat> &strip, vector<Rect> &glyph_rect)
+{
+	strip.assign(channel.size(), Mat());
+	glyph_rect.resize(text.ers.size());
+
+	if (abs(text.slope) <= 0.01)
+	{
+		for (int j = 0; j < text.ers.size(); j++)
+		{
+			strip[text.ers[j]->ch] = channel[text.ers[j]->ch];
+			glyph_rect[j] = text.ers[j]->bound;
+		}
+		return;
+	}
+
+	// line region with a small margin so that the corners of the glyphs survive the rotation
+	Rect region = text.ers.front()->bound;
+	for (int j = 0; j < text.ers.size(); j++)
+		region |= text.ers[j]->bound;
+	const int margin = region.height / 4 + 1;
+	region = Rect(region.x - margin, region.y - margin, region.width + 2 * margin, region.height + 2 * margin);
+	region &= Rect(0, 0, channel[0].cols, channel[0].rows);
+
+	// rotate by the line angle around the region center and shift the result into the strip
+	const double rad = atan(text.slope);
+	const double c = cos(rad);
+	const double s = sin(rad);
+	const Size strip_size(cvCeil(region.width * abs(c) + region.height * abs(s)), cvCeil(region.width * abs(s) + region.height * abs(c)));
+	Mat M = getRotationMatrix2D(Point2f((region.width - 1) * 0.5f, (region.height - 1) * 0.5f), rad * 180 / CV_PI, 1.0);
+	M.at<double>(0, 2) += (strip_size.width - region.width) * 0.5;
+	M.at<double>(1, 2) += (strip_size.height - region.height) * 0.5;
+
+	for (int j = 0; j < text.ers.size(); j++)
+	{
+		const int ch = text.ers[j]->ch;
+		if (strip[ch].empty())
+			warpAffine(channel[ch](region), strip[ch], M, strip_size, INTER_LINEAR, BORDER_REPLICATE);
+	}
+
+	// the upright box (w', h') of a glyph rotated by rad has the axis aligned bound
+	// w = w'cos + h'sin, h = w'sin + h'cos, solve it back and center it on the rotated center
+	const double *m = M.ptr<double>(0);
+	const double cos2 = c * c - s * s;
+	const Rect strip_rect(0, 0, strip_size.width, strip_size.height);
+	for (int j = 0; j < text.ers.size(); j++)
+	{
+		const Rect &b = text.ers[j]->bound;
+		const double cx = b.x - region.x + (b.width - 1) * 0.5;
+		const double cy = b.y - region.y + (b.height - 1) * 0.5;
+		const double new_cx = m[0] * cx + m[1] * cy + m[2];
+		const double new_cy = m[3] * cx + m[4] * cy + m[5];
+
+		double w = (cos2 > 0.1) ? (b.width * c - b.height * abs(s)) / cos2 : 0;
+		double h = (cos2 > 0.1) ? (b.height * c - b.width * abs(s)) / cos2 : 0;
+		if (w < 1 || h < 1)
+		{
+			w = b.width;
+			h = b.height;
+		}
+
+		Rect r(cvRound(new_cx - (w - 1) * 0.5), cvRound(new_cy - (h - 1) * 0.5), cvRound(w), cvRound(h));
+		r &= strip_rect;
+		glyph_rect[j] = (r.area() > 0) ? r : Rect(cvRound(new_cx), cvRound(new_cy), 1, 1) & strip_rect;
+	}
 }
 
 
@@ -845,7 +1064,7 @@ vector<double> ERFilter::make_LBP_hist(Mat input, const int N, const int normali
 
 Mat ERFilter::calc_LBP(Mat input, const int size)
 {
-	ocr->ARAN(input, input, size + 2);
+	OCR::ARAN(input, input, size + 2);
 	//resize(input, input, Size(size + 2, size + 2));
 
 	Mat LBP = Mat::zeros(size, size, CV_8U);
@@ -994,9 +1213,14 @@ void ERFilter::overlap_suppression(ERs &pool)
 // model as a graph problem
 void ERFilter::build_graph(Text &text, Graph &graph)
 {
+	graph.clear();
 	for (int j = 0; j < text.ers.size(); j++)
-		graph.push_back(GraphNode(text.ers[j], j));
+	{
+		graph.vertex.push_back(text.ers[j]);
+		graph.label.push_back(ocr->index_mapping(text.ers[j]->letter));
+	}
 
+	graph.offset.push_back(0);
 	for (int j = 0; j < text.ers.size(); j++)
 	{
 		bool found_next = false;
@@ -1013,10 +1237,8 @@ void ERFilter::build_graph(Text &text, Graph &graph)
 				found_next = true;
 				cmp_idx = k;
 
-				const int a = ocr->index_mapping(graph[j].vertex->letter);
-				const int b = ocr->index_mapping(graph[k].vertex->letter);
-				graph[j].edge_prob.push_back(tp[a][b]);
-				graph[j].adj_list.push_back(graph[k]);
+				graph.edge_prob.push_back(tp[graph.label[j]][graph.label[k]]);
+				graph.adj.push_back(k);
 			}
 
 			// encounter an ER that is overlapping to cmp_idx
@@ -1024,16 +1246,15 @@ void ERFilter::build_graph(Text &text, Graph &graph)
 			{
 				cmp_idx = k;
 
-				const int a = ocr->index_mapping(graph[j].vertex->letter);
-				const int b = ocr->index_mapping(graph[k].vertex->letter);
-				graph[j].edge_prob.push_back(tp[a][b]);
-				graph[j].adj_list.push_back(graph[k]);
+				graph.edge_prob.push_back(tp[graph.label[j]][graph.label[k]]);
+				graph.adj.push_back(k);
 			}
 
 			// encounter an ER that is different from cmp_idx, the stream is ended
 			else
 				break;
 		}
+		graph.offset.push_back(graph.adj.size());
 	}
 }
 
@@ -1041,20 +1262,22 @@ void ERFilter::build_graph(Text &text, Graph &graph)
 // solve the graph problem by Dynamic Programming
 void ERFilter::solve_graph(Text &text, Graph &graph)
 {
-	vector<double> DP_score(graph.size(), 0);
-	vector<int> DP_path(graph.size(), -1);
+	vector<double> &DP_score = graph.score;
+	vector<int> &DP_path = graph.path;
+	DP_score.assign(graph.size(), 0);
+	DP_path.assign(graph.size(), -1);
 	const double char_weight = 100;
 	const double edge_weight = 50;
 
 	for (int j = 0; j < graph.size(); j++)
 	{
 		if (DP_path[j] == -1)
-			DP_score[j] = graph[j].vertex->prob * char_weight;
+			DP_score[j] = graph.vertex[j]->prob * char_weight;
 
-		for (int k = 0; k < graph[j].adj_list.size(); k++)
+		for (int e = graph.offset[j]; e < graph.offset[j + 1]; e++)
 		{
-			const int &adj = graph[j].adj_list[k].index;
-			const double score = DP_score[j] + graph[j].edge_prob[k] * edge_weight + text.ers[adj]->prob * char_weight;
+			const int &adj = graph.adj[e];
+			const double score = DP_score[j] + graph.edge_prob[e] * edge_weight + graph.vertex[adj]->prob * char_weight;
 			
 			if (score > DP_score[adj])
 			{
@@ -1081,7 +1304,7 @@ void ERFilter::solve_graph(Text &text, Graph &graph)
 	text.ers.clear();
 	while (node_idx != -1)
 	{
-		text.ers.push_back(graph[node_idx].vertex);
+		text.ers.push_back(graph.vertex[node_idx]);
 		node_idx = DP_path[node_idx];
 	}
 
@@ -1092,9 +1315,208 @@ void ERFilter::solve_graph(Text &text, Graph &graph)
 }
 
 
+// Decode the line over the lattice of every path in the graph times every OCR candidate of its vertices.
+// The score of a hypothesis is the same as solve_graph, only the BEAM_WIDTH best hypotheses that end
+// on a vertex are kept, so the cost is bounded by edges * BEAM_WIDTH * OCR_TOP_K.
+// With a lexicon, a hypothesis loses LEX_WEIGHT for every edit between its text and the closest word.
+void ERFilter::beam_search(Text &text, Graph &graph, vector<vector<double>> &candidates)
+{
+	typedef Graph::Hypothesis Hypothesis;
+	const double char_weight = 100;
+	const double edge_weight = 50;
+	const int n = graph.size();
+
+	// incoming edges
+	graph.in_offset.assign(n + 1, 0);
+	for (int e = 0; e < graph.adj.size(); e++)
+		graph.in_offset[graph.adj[e] + 1]++;
+	for (int j = 0; j < n; j++)
+		graph.in_offset[j + 1] += graph.in_offset[j];
+	graph.in_vertex.resize(graph.adj.size());
+	vector<int> fill(graph.in_offset.begin(), graph.in_offset.end() - 1);
+	for (int j = 0; j < n; j++)
+	{
+		for (int e = graph.offset[j]; e < graph.offset[j + 1]; e++)
+			graph.in_vertex[fill[graph.adj[e]]++] = j;
+	}
+
+	// with a lexicon every hypothesis carries the Levenshtein automaton states of its current word.
+	// The automaton restarts at the gaps OCR::try_add_space turns into spaces, the median distance
+	// is taken over the edges since the path is not known yet
+	const bool use_lexicon = (lexicon != nullptr);
+	double median_gap = 0;
+	if (use_lexicon)
+	{
+		lexicon->start(graph.lex_root, LEX_MAX_EDIT);
+
+		graph.gap.clear();
+		for (int j = 0; j < n; j++)
+		{
+			for (int e = graph.offset[j]; e < graph.offset[j + 1]; e++)
+			{
+				const double d = graph.vertex[graph.adj[e]]->bound.x - graph.vertex[j]->bound.br().x;
+				if (d >= 0)
+					graph.gap.push_back(d);
+			}
+		}
+		if (!graph.gap.empty())
+		{
+			nth_element(graph.gap.begin(), graph.gap.begin() + graph.gap.size() / 2, graph.gap.end());
+			median_gap = graph.gap[graph.gap.size() / 2];
+		}
+	}
+	graph.lex_pool.clear();
+
+	graph.hyp.clear();
+	graph.hyp_offset.assign(1, 0);
+	for (int k = 0; k < n; k++)
+	{
+		vector<Hypothesis> &expand = graph.expand;
+		expand.clear();
+		graph.dead.clear();
+		graph.lex_expand.clear();
+
+		auto extend = [&](const int h, const double score, const int c, const int label, const char letter)
+		{
+			Hypothesis hyp = { score, k, c, label, h, 0, 0, -1 };
+			if (!use_lexicon)
+			{
+				expand.push_back(hyp);
+				return;
+			}
+
+			// a new word first pays for the letters still missing to complete the previous one
+			bool new_word = (h == -1);
+			if (!new_word && OCR::is_word_gap(graph.vertex[k]->bound.x - graph.vertex[graph.hyp[h].vertex]->bound.br().x, median_gap))
+			{
+				const Hypothesis &prev = graph.hyp[h];
+				if (prev.lex_cost >= 0)
+					hyp.score -= (lexicon->final_cost(&graph.lex_pool[prev.lex_begin], prev.lex_end - prev.lex_begin, LEX_MAX_EDIT) - prev.lex_cost) * LEX_WEIGHT;
+				new_word = true;
+			}
+
+			const int prev_cost = new_word ? 0 : graph.hyp[h].lex_cost;
+			if (prev_cost < 0)
+			{
+				expand.push_back(hyp);
+				return;
+			}
+
+			const Lexicon::State *from = new_word ? graph.lex_root.data() : &graph.lex_pool[graph.hyp[h].lex_begin];
+			const int from_num = new_word ? graph.lex_root.size() : graph.hyp[h].lex_end - graph.hyp[h].lex_begin;
+			if (lexicon->step(from, from_num, letter, graph.lex_step, LEX_MAX_EDIT))
+			{
+				hyp.lex_cost = graph.lex_step.front().cost;
+				hyp.score -= (hyp.lex_cost - prev_cost) * LEX_WEIGHT;
+				hyp.lex_begin = graph.lex_expand.size();
+				graph.lex_expand.insert(graph.lex_expand.end(), graph.lex_step.begin(), graph.lex_step.end());
+				hyp.lex_end = graph.lex_expand.size();
+				expand.push_back(hyp);
+			}
+			else
+			{
+				// the word leaves the lexicon. A non-letter (digits, symbols) goes on with the penalty of a miss,
+				// a letter that no word within LEX_MAX_EDIT edits continues with is pruned unless nothing else is left
+				hyp.score -= (LEX_MAX_EDIT + 1 - prev_cost) * LEX_WEIGHT;
+				if (isalpha((unsigned char)letter))
+					graph.dead.push_back(hyp);
+				else
+					expand.push_back(hyp);
+			}
+		};
+
+		for (int c = 0; c < candidates[k].size(); c++)
+		{
+			const char letter = floor(candidates[k][c]);
+			const double prob = candidates[k][c] - letter;
+			const int label = ocr->index_mapping(letter);
+			if (label < 0)
+				continue;
+
+			// a vertex without incoming edge starts a path, the same as solve_graph
+			if (graph.in_offset[k] == graph.in_offset[k + 1])
+				extend(-1, prob * char_weight, c, label, letter);
+
+			for (int in = graph.in_offset[k]; in < graph.in_offset[k + 1]; in++)
+			{
+				const int j = graph.in_vertex[in];
+				for (int h = graph.hyp_offset[j]; h < graph.hyp_offset[j + 1]; h++)
+				{
+					const Hypothesis &prev = graph.hyp[h];
+					extend(h, prev.score + tp[prev.label][label] * edge_weight + prob * char_weight, c, label, letter);
+				}
+			}
+		}
+
+		if (expand.empty())
+			expand.swap(graph.dead);
+
+		const int keep = min<int>(BEAM_WIDTH, expand.size());
+		partial_sort(expand.begin(), expand.begin() + keep, expand.end(), [](const Hypothesis &a, const Hypothesis &b) { return a.score > b.score; });
+		for (int i = 0; i < keep; i++)
+		{
+			Hypothesis kept = expand[i];
+			if (kept.lex_cost >= 0)
+			{
+				const int begin = graph.lex_pool.size();
+				graph.lex_pool.insert(graph.lex_pool.end(), graph.lex_expand.begin() + kept.lex_begin, graph.lex_expand.begin() + kept.lex_end);
+				kept.lex_begin = begin;
+				kept.lex_end = graph.lex_pool.size();
+			}
+			graph.hyp.push_back(kept);
+		}
+		graph.hyp_offset.push_back(graph.hyp.size());
+	}
+
+	// backtrack from the best hypothesis of all vertices, a last word inside the lexicon
+	// also pays for the letters still missing to complete it
+	int best = -1;
+	double best_score = 0;
+	for (int h = 0; h < graph.hyp.size(); h++)
+	{
+		double score = graph.hyp[h].score;
+		if (use_lexicon && graph.hyp[h].lex_cost >= 0)
+		{
+			const int cost = lexicon->final_cost(&graph.lex_pool[graph.hyp[h].lex_begin], graph.hyp[h].lex_end - graph.hyp[h].lex_begin, LEX_MAX_EDIT);
+			score -= (cost - graph.hyp[h].lex_cost) * LEX_WEIGHT;
+		}
+
+		if (best == -1 || score > best_score)
+		{
+			best = h;
+			best_score = score;
+		}
+	}
+
+	// no candidate is a known letter, fall back to the top-1 path
+	if (best == -1)
+	{
+		solve_graph(text, graph);
+		return;
+	}
+
+	text.ers.clear();
+	while (best != -1)
+	{
+		const Hypothesis &h = graph.hyp[best];
+		ER *er = graph.vertex[h.vertex];
+		const double result = candidates[h.vertex][h.cand];
+		er->letter = floor(result);
+		er->prob = result - floor(result);
+		text.ers.push_back(er);
+		best = h.prev;
+	}
+
+	reverse(text.ers.begin(), text.ers.end());
+
+	for (auto it : text.ers)
+		text.word.append(string(1, it->letter));
+}
+
+
 void ERFilter::spell_check(Text &text)
 {
-	if (text.word.length() <= 1)
+	if (corrector == nullptr || text.word.length() <= 1)
 		return;
 
 	for (auto it : text.word)
@@ -1106,7 +1528,7 @@ void ERFilter::spell_check(Text &text)
 	transform(request.begin(), request.end(), request.begin(), ::tolower);
 
 	//cout << text.word << " -> ";
-	string corrected = corrector.correct(request);
+	string corrected = corrector->correct(request);
 	int upper_count = 0;
 	int lower_count = 0;
 	for (int i = 0; i < corrected.length(); i++)
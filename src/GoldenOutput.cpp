@@ -0,0 +1,357 @@
+#include "../inc/GoldenOutput.h"
+#include "../inc/utils.h"
+
+
+GoldenOutput::GoldenOutput(double _iou_t, double _prob_tol, int _word_edit) : IOU_T(_iou_t), PROB_TOL(_prob_tol), WORD_EDIT(_word_edit)
+{
+}
+
+
+const char* GoldenOutput::stage_name(int stage)
+{
+	static const char *name[STAGE_NUM] = { "pool", "strong", "weak", "tracked", "group", "letter", "word" };
+	return name[stage];
+}
+
+
+void GoldenOutput::clear()
+{
+	images.clear();
+}
+
+
+const vector<GoldenOutput::Image>& GoldenOutput::get_images()
+{
+	return images;
+}
+
+
+void GoldenOutput::add_er(vector<Item> &items, ER *er, int ch)
+{
+	Item item;
+	item.ch = ch;
+	item.box = er->bound;
+	item.prob = 0;
+	items.push_back(item);
+}
+
+
+// the pool, strong and weak ERs take the channel from their list, er_track only sets ch of strong and weak
+void GoldenOutput::capture(ERFilter *er_filter, Mat &src, int index)
+{
+	ERs root;
+	vector<ERs> all;
+	vector<ERs> pool;
+	vector<ERs> strong;
+	vector<ERs> weak;
+	ERs tracked;
+	vector<Text> text;
+	vector<Text> group;
+
+	er_filter->set_group_output(&group);
+	er_filter->text_detect(src, root, all, pool, strong, weak, tracked, text);
+	er_filter->set_group_output(nullptr);
+
+	Image image;
+	image.index = index;
+	image.stage.resize(STAGE_NUM);
+
+	for (int i = 0; i < pool.size(); i++)
+	{
+		for (auto it : pool[i])
+			add_er(image.stage[POOL], it, i);
+		for (auto it : strong[i])
+			add_er(image.stage[STRONG], it, i);
+		for (auto it : weak[i])
+			add_er(image.stage[WEAK], it, i);
+	}
+
+	for (auto it : tracked)
+		add_er(image.stage[TRACKED], it, it->ch);
+
+	for (auto &it : group)
+		image.stage[GROUP].push_back({ -1, it.box, 0, to_string(it.ers.size()) });
+
+	if (er_filter->get_pipeline() & PIPELINE_OCR)
+	{
+		for (auto &it : text)
+		{
+			for (auto er : it.ers)
+				image.stage[LETTER].push_back({ er->ch, er->bound, er->prob, string(1, er->letter) });
+			image.stage[WORD].push_back({ -1, it.box, 0, it.word });
+		}
+	}
+
+	for (auto &it : image.stage)
+		sort(it.begin(), it.end(), item_less);
+	images.push_back(image);
+
+	for (auto it : root)
+		er_filter->er_delete(it);
+}
+
+
+// golden <image number>
+// image <index>
+// <stage> <item number>
+// <ch> <x> <y> <width> <height> <prob> <label>		one line per item, the label is the rest of the line
+bool GoldenOutput::write(const string &filename)
+{
+	fstream fout(filename, fstream::out);
+	if (!fout.is_open())
+		return false;
+
+	fout.precision(17);
+	fout << "golden " << images.size() << "\n";
+	for (auto &image : images)
+	{
+		fout << "image " << image.index << "\n";
+		for (int s = 0; s < STAGE_NUM; s++)
+		{
+			fout << stage_name(s) << " " << image.stage[s].size() << "\n";
+			for (auto &it : image.stage[s])
+				fout << it.ch << " " << it.box.x << " " << it.box.y << " " << it.box.width << " " << it.box.height << " " << it.prob << " " << it.label << "\n";
+		}
+	}
+	return true;
+}
+
+
+bool GoldenOutput::read(const string &filename)
+{
+	fstream fin(filename, fstream::in);
+	if (!fin.is_open())
+		return false;
+
+	images.clear();
+	string tag;
+	int image_num;
+	if (!(fin >> tag >> image_num) || tag != "golden")
+		return false;
+
+	for (int n = 0; n < image_num; n++)
+	{
+		Image image;
+		image.stage.resize(STAGE_NUM);
+		if (!(fin >> tag >> image.index) || tag != "image")
+			return false;
+
+		for (int s = 0; s < STAGE_NUM; s++)
+		{
+			size_t item_num;
+			if (!(fin >> tag >> item_num) || tag != stage_name(s))
+				return false;
+
+			image.stage[s].resize(item_num);
+			for (auto &it : image.stage[s])
+			{
+				fin >> it.ch >> it.box.x >> it.box.y >> it.box.width >> it.box.height >> it.prob;
+				fin.get();
+				getline(fin, it.label);
+				if (!it.label.empty() && it.label.back() == '\r')
+					it.label.pop_back();
+			}
+			if (!fin)
+				return false;
+		}
+		images.push_back(image);
+	}
+	return true;
+}
+
+
+bool GoldenOutput::item_less(const Item &a, const Item &b)
+{
+	if (a.ch != b.ch)					return a.ch < b.ch;
+	if (a.box.x != b.box.x)				return a.box.x < b.box.x;
+	if (a.box.y != b.box.y)				return a.box.y < b.box.y;
+	if (a.box.width != b.box.width)		return a.box.width < b.box.width;
+	if (a.box.height != b.box.height)	return a.box.height < b.box.height;
+	if (a.label != b.label)				return a.label < b.label;
+	return a.prob < b.prob;
+}
+
+
+bool GoldenOutput::item_equal(const Item &a, const Item &b)
+{
+	return a.ch == b.ch && a.box == b.box && a.label == b.label && a.prob == b.prob;
+}
+
+
+double GoldenOutput::iou(const Rect &a, const Rect &b)
+{
+	const double inter = (a & b).area();
+	const double uni = a.area() + b.area() - inter;
+	return (uni > 0) ? inter / uni : 0;
+}
+
+
+bool GoldenOutput::compatible(int stage, const Item &a, const Item &b, double &prob_diff)
+{
+	prob_diff = 0;
+	if (a.ch != b.ch)
+		return false;
+
+	if (stage == LETTER)
+	{
+		prob_diff = abs(a.prob - b.prob);
+		return a.label == b.label && prob_diff <= PROB_TOL;
+	}
+	if (stage == WORD)
+		return levenshtein_distance(a.label, b.label) <= WORD_EDIT;
+	return true;
+}
+
+
+vector<GoldenOutput::StageDiff> GoldenOutput::compare(GoldenOutput &test, ostream &detail, int max_detail)
+{
+	vector<StageDiff> diff(STAGE_NUM, StageDiff{ 0, 0, 0, 0, 0, 0, 0 });
+	vector<int> detail_count(STAGE_NUM, 0);
+
+	auto print_item = [&](const char *what, int stage, int index, const Item &it) {
+		if (detail_count[stage]++ >= max_detail)
+			return;
+		detail << stage_name(stage) << "\timage " << index << "\t" << what << "\tch " << it.ch << "\t[" << it.box.x << "," << it.box.y << ","
+			<< it.box.width << "," << it.box.height << "]\t" << it.prob << "\t" << it.label << "\n";
+	};
+
+	// an image on one side only, every item of it is a miss of both comparisons
+	auto count_unpaired = [&](const Image &image, bool in_ref) {
+		for (int s = 0; s < STAGE_NUM; s++)
+		{
+			const long long n = image.stage[s].size();
+			StageDiff &d = diff[s];
+			++d.image_num;
+			(in_ref ? d.ref_count : d.test_count) += n;
+			d.exact_miss += n;
+			d.tol_miss += n;
+		}
+	};
+
+	for (auto &ref_image : images)
+	{
+		const Image *test_image = nullptr;
+		for (auto &it : test.images)
+		{
+			if (it.index == ref_image.index)
+			{
+				test_image = &it;
+				break;
+			}
+		}
+		if (test_image == nullptr)
+		{
+			detail << "image " << ref_image.index << " is missing from the test output\n";
+			count_unpaired(ref_image, true);
+			continue;
+		}
+
+		for (int s = 0; s < STAGE_NUM; s++)
+		{
+			const vector<Item> &ref = ref_image.stage[s];
+			const vector<Item> &cand = test_image->stage[s];
+			StageDiff &d = diff[s];
+			++d.image_num;
+			d.ref_count += ref.size();
+			d.test_count += cand.size();
+
+			// exact: symmetric difference of the sorted multisets
+			long long miss = 0;
+			int i = 0, j = 0;
+			while (i < ref.size() || j < cand.size())
+			{
+				if (j == cand.size() || (i < ref.size() && item_less(ref[i], cand[j])))
+				{
+					++miss;
+					++i;
+				}
+				else if (i == ref.size() || item_less(cand[j], ref[i]))
+				{
+					++miss;
+					++j;
+				}
+				else
+				{
+					++i;
+					++j;
+				}
+			}
+			d.exact_miss += miss;
+			if (miss == 0)
+				++d.exact_image;
+
+			// tolerance: every reference item takes the compatible candidate with the highest IoU
+			vector<bool> paired(cand.size(), false);
+			for (auto &r : ref)
+			{
+				int best = -1;
+				double best_iou = IOU_T;
+				double best_prob_diff = 0;
+				for (int k = 0; k < cand.size(); k++)
+				{
+					double prob_diff;
+					if (paired[k] || !compatible(s, r, cand[k], prob_diff))
+						continue;
+					const double o = iou(r.box, cand[k].box);
+					if (o >= best_iou)
+					{
+						best = k;
+						best_iou = o;
+						best_prob_diff = prob_diff;
+					}
+				}
+
+				if (best < 0)
+				{
+					++d.tol_miss;
+					print_item("only in reference", s, ref_image.index, r);
+				}
+				else
+				{
+					paired[best] = true;
+					d.max_prob_diff = max(d.max_prob_diff, best_prob_diff);
+				}
+			}
+			for (int k = 0; k < cand.size(); k++)
+			{
+				if (!paired[k])
+				{
+					++d.tol_miss;
+					print_item("only in test", s, ref_image.index, cand[k]);
+				}
+			}
+		}
+	}
+
+	for (auto &test_image : test.images)
+	{
+		bool found = false;
+		for (auto &it : images)
+		{
+			if (it.index == test_image.index)
+			{
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+		{
+			detail << "image " << test_image.index << " is missing from the reference output\n";
+			count_unpaired(test_image, false);
+		}
+	}
+
+	return diff;
+}
+
+
+void GoldenOutput::print_report(const vector<StageDiff> &diff, ostream &out)
+{
+	out << "stage\timages\texact images\treference\ttest\texact diff\ttolerance diff\tmax prob diff\n";
+	for (int s = 0; s < diff.size(); s++)
+	{
+		const StageDiff &d = diff[s];
+		out << stage_name(s) << "\t" << d.image_num << "\t" << d.exact_image << "\t" << d.ref_count << "\t" << d.test_count << "\t"
+			<< d.exact_miss << "\t" << d.tol_miss << "\t" << d.max_prob_diff << "\n";
+	}
+}
@@ -0,0 +1,407 @@
+#include "../inc/Lexicon.h"
+
+#include <queue>
+#include <unordered_map>
+
+static const char lexicon_magic[4] = { 'L', 'E', 'X', '1' };
+
+
+Lexicon::Lexicon() : word_num(0)
+{
+	vector<string> empty;
+	build(empty);
+}
+
+
+// A file that starts with "LEX1" is a lexicon written by save(), anything else is tokenized the same
+// way as SpellingCorrector::load and every word appearing at least min_count times is kept
+bool Lexicon::load(const string &filename, const int min_count)
+{
+	fstream fin(filename, fstream::in | fstream::binary);
+	if (!fin.is_open())
+		return false;
+
+	char magic[4] = { 0 };
+	fin.read(magic, 4);
+	if (fin && memcmp(magic, lexicon_magic, 4) == 0)
+	{
+		unsigned long long words, nodes;
+		fin.read((char*)&words, sizeof(words));
+		fin.read((char*)&nodes, sizeof(nodes));
+		if (!fin)
+			return false;
+
+		// the arrays must fill the rest of the file, a bad count fails before anything is allocated
+		const unsigned long long header_size = 4 + sizeof(words) + sizeof(nodes);
+		fin.seekg(0, fstream::end);
+		const unsigned long long length = fin.tellg();
+		const unsigned long long node_size = sizeof(int) * 2 + sizeof(unsigned);
+		if (nodes == 0 || length < header_size || (length - header_size) / node_size < nodes)
+			return false;
+		fin.seekg(header_size, fstream::beg);
+
+		vector<int> file_base(nodes);
+		vector<int> file_check(nodes);
+		vector<unsigned> file_mask(nodes);
+		fin.read((char*)file_base.data(), sizeof(int) * nodes);
+		fin.read((char*)file_check.data(), sizeof(int) * nodes);
+		fin.read((char*)file_mask.data(), sizeof(unsigned) * nodes);
+		if (!fin)
+			return false;
+
+		// the walks index base[s] + c for every child bit c of mask[s] without checks, a corrupt file must fail here
+		if (file_check[0] != 0)
+			return false;
+		for (unsigned long long s = 0; s < nodes; s++)
+		{
+			if (file_mask[s] >> 27)
+				return false;
+			for (unsigned m = file_mask[s] & ~1u; m; m &= m - 1)
+			{
+				int c = 0;
+				while (!(m >> c & 1))
+					c++;
+				const long long t = (long long)file_base[s] + c;
+				if (t < 1 || t >= (long long)nodes || file_check[t] != (long long)s)
+					return false;
+			}
+		}
+
+		base.swap(file_base);
+		check.swap(file_check);
+		mask.swap(file_mask);
+		word_num = words;
+		return true;
+	}
+
+	fin.clear();
+	fin.seekg(0, fstream::end);
+	const size_t length = fin.tellg();
+	fin.seekg(0, fstream::beg);
+	string data(length, '\0');
+	fin.read(&data[0], length);
+
+	unordered_map<string, int> count;
+	size_t i = 0;
+	while (i < data.size())
+	{
+		while (i < data.size() && letter_code(data[i]) == 0)
+			i++;
+		const size_t begin = i;
+		while (i < data.size() && letter_code(data[i]) != 0)
+		{
+			data[i] = tolower(data[i]);
+			i++;
+		}
+		if (i > begin)
+			count[data.substr(begin, i - begin)]++;
+	}
+
+	vector<string> words;
+	for (auto &it : count)
+	{
+		if (it.second >= min_count)
+			words.push_back(it.first);
+	}
+	build(words);
+
+	return true;
+}
+
+
+bool Lexicon::save(const string &filename)
+{
+	fstream fout(filename, fstream::out | fstream::binary);
+	if (!fout.is_open())
+		return false;
+
+	const unsigned long long words = word_num;
+	const unsigned long long nodes = base.size();
+	fout.write(lexicon_magic, 4);
+	fout.write((char*)&words, sizeof(words));
+	fout.write((char*)&nodes, sizeof(nodes));
+	fout.write((char*)base.data(), sizeof(int) * nodes);
+	fout.write((char*)check.data(), sizeof(int) * nodes);
+	fout.write((char*)mask.data(), sizeof(unsigned) * nodes);
+
+	return !fout.fail();
+}
+
+
+// Words are sorted, then the trie is laid out breadth first: the children of a node are the words of
+// its range sharing the next letter, and its base is the first one whose child slots are all free.
+// Free slots are chained in a doubly linked list, so the search only visits free slots.
+void Lexicon::build(vector<string> &words)
+{
+	sort(words.begin(), words.end());
+	words.erase(unique(words.begin(), words.end()), words.end());
+	words.erase(remove(words.begin(), words.end(), string()), words.end());
+	word_num = words.size();
+
+	base.clear();
+	check.clear();
+	mask.clear();
+	vector<int> next_free;
+	vector<int> prev_free;
+	int free_head = -1;
+	int free_tail = -1;
+
+	auto reserve = [&](size_t n)
+	{
+		if (n <= check.size())
+			return;
+		const int old_size = check.size();
+		size_t new_size = max<size_t>(old_size, 1024);
+		while (new_size < n)
+			new_size *= 2;
+		base.resize(new_size, 0);
+		check.resize(new_size, -1);
+		mask.resize(new_size, 0);
+		next_free.resize(new_size, -1);
+		prev_free.resize(new_size, -1);
+		for (size_t t = old_size; t < new_size; t++)
+		{
+			prev_free[t] = free_tail;
+			if (free_tail == -1)
+				free_head = t;
+			else
+				next_free[free_tail] = t;
+			free_tail = t;
+		}
+	};
+
+	auto occupy = [&](int t, int parent)
+	{
+		check[t] = parent;
+		if (prev_free[t] == -1)
+			free_head = next_free[t];
+		else
+			next_free[prev_free[t]] = next_free[t];
+		if (next_free[t] == -1)
+			free_tail = prev_free[t];
+		else
+			prev_free[next_free[t]] = prev_free[t];
+	};
+
+	reserve(1024);
+	occupy(0, 0);
+
+	struct Range
+	{
+		int node;
+		int begin;
+		int end;
+		int depth;
+	};
+	queue<Range> todo;
+	todo.push({ 0, 0, (int)words.size(), 0 });
+
+	int used = 1;
+	vector<int> codes;
+	vector<int> child_begin;
+	while (!todo.empty())
+	{
+		const Range r = todo.front();
+		todo.pop();
+
+		// sorted, so a word ending here comes first
+		int i = r.begin;
+		if (i < r.end && (int)words[i].size() == r.depth)
+		{
+			mask[r.node] |= 1;
+			i++;
+		}
+
+		codes.clear();
+		child_begin.clear();
+		for (; i < r.end; i++)
+		{
+			const int c = letter_code(words[i][r.depth]);
+			if (codes.empty() || codes.back() != c)
+			{
+				codes.push_back(c);
+				child_begin.push_back(i);
+			}
+		}
+		child_begin.push_back(r.end);
+
+		if (codes.empty())
+			continue;
+
+		// the slot of the first child walks the free list
+		int b;
+		int e = free_head;
+		while (true)
+		{
+			if (e == -1)
+			{
+				const int old_size = check.size();
+				reserve(old_size * 2);
+				e = old_size;
+			}
+
+			b = e - codes.front();
+			if (b >= 1)
+			{
+				reserve(b + 27);
+				bool fit = true;
+				for (auto c : codes)
+				{
+					if (check[b + c] != -1)
+					{
+						fit = false;
+						break;
+					}
+				}
+				if (fit)
+					break;
+			}
+			e = next_free[e];
+		}
+
+		base[r.node] = b;
+		for (int k = 0; k < (int)codes.size(); k++)
+		{
+			const int t = b + codes[k];
+			occupy(t, r.node);
+			mask[r.node] |= 1u << codes[k];
+			used = max(used, t + 1);
+			todo.push({ t, child_begin[k], child_begin[k + 1], r.depth + 1 });
+		}
+	}
+
+	base.resize(used);
+	check.resize(used);
+	mask.resize(used);
+	base.shrink_to_fit();
+	check.shrink_to_fit();
+	mask.shrink_to_fit();
+}
+
+
+bool Lexicon::contains(const string &word)
+{
+	int node = 0;
+	for (auto ch : word)
+	{
+		const int c = letter_code(ch);
+		if (c == 0 || !(mask[node] >> c & 1))
+			return false;
+		node = base[node] + c;
+	}
+	return mask[node] & 1;
+}
+
+
+size_t Lexicon::size()
+{
+	return word_num;
+}
+
+
+size_t Lexicon::node_num()
+{
+	return base.size();
+}
+
+
+void Lexicon::start(vector<State> &states, const int max_edit)
+{
+	states.assign(1, { 0, 0 });
+	closure(states, max_edit);
+}
+
+
+bool Lexicon::step(const State *from, const int from_num, const char letter, vector<State> &to, const int max_edit)
+{
+	to.clear();
+	const int c = letter_code(letter);
+	if (c == 0)
+		return false;
+
+	for (int i = 0; i < from_num; i++)
+	{
+		const State &s = from[i];
+		// the letter is extra
+		if (s.cost < max_edit)
+			to.push_back({ s.node, s.cost + 1 });
+
+		// the letter matches or replaces a letter of the word, at the edit limit only a match is possible
+		if (s.cost == max_edit)
+		{
+			if (mask[s.node] >> c & 1)
+				to.push_back({ base[s.node] + c, s.cost });
+			continue;
+		}
+
+		for (unsigned m = mask[s.node] & ~1u; m; m &= m - 1)
+		{
+			int y = 0;
+			while (!(m >> y & 1))
+				y++;
+			to.push_back({ base[s.node] + y, s.cost + (y != c) });
+		}
+	}
+
+	closure(to, max_edit);
+	return !to.empty();
+}
+
+
+int Lexicon::final_cost(const State *states, const int state_num, const int max_edit)
+{
+	int cost = max_edit + 1;
+	for (int i = 0; i < state_num; i++)
+	{
+		if (mask[states[i].node] & 1)
+			cost = min(cost, states[i].cost);
+	}
+	return cost;
+}
+
+
+int Lexicon::letter_code(const char c)
+{
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 1;
+	else if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 1;
+	else
+		return 0;
+}
+
+
+// add the letters of the word missing from the text one edit level at a time, after every level
+// only the cheapest entry of every node is kept. An entry of cost level can not get cheaper at a
+// later level, so the cost of every node is its exact edit distance. There is no cap on the number
+// of entries: dropping one would reject prefixes that are still within max_edit of a word.
+void Lexicon::closure(vector<State> &states, const int max_edit)
+{
+	auto normalize = [&]()
+	{
+		sort(states.begin(), states.end(), [](const State &a, const State &b) { return a.node < b.node || (a.node == b.node && a.cost < b.cost); });
+		states.erase(unique(states.begin(), states.end(), [](const State &a, const State &b) { return a.node == b.node; }), states.end());
+		stable_sort(states.begin(), states.end(), [](const State &a, const State &b) { return a.cost < b.cost; });
+	};
+
+	normalize();
+	for (int level = 0; level < max_edit; level++)
+	{
+		const int n = states.size();
+		for (int i = 0; i < n; i++)
+		{
+			if (states[i].cost != level)
+				continue;
+
+			const State s = states[i];
+			for (unsigned m = mask[s.node] & ~1u; m; m &= m - 1)
+			{
+				int y = 0;
+				while (!(m >> y & 1))
+					y++;
+				states.push_back({ base[s.node] + y, s.cost + 1 });
+			}
+		}
+		normalize();
+	}
+}
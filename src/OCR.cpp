@@ -1,6 +1,16 @@
 ﻿#include "../inc/OCR.h"
 #include "../inc/ER.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#define POPCOUNT64(x) __popcnt64(x)
+#else
+#define POPCOUNT64(x) __builtin_popcountll(x)
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 enum category
 {
 	big = 2,
@@ -15,9 +25,25 @@ big, big, big};
 
 
 
-OCR::OCR(const char *svm_file_name, int _img_L, int _feature_L) : img_L(_img_L), feature_L(_feature_L)
+OCR::OCR(const char *model_file_name, int _img_L, int _feature_L) : img_L(_img_L), feature_L(_feature_L), fused_feature(false)
 {
-	model = svm_load_model(svm_file_name);
+	if (RFFClassifier::is_rff_file(model_file_name))
+	{
+		shared_ptr<RFFClassifier> rff = make_shared<RFFClassifier>(this);
+		if (!rff->load(model_file_name))
+			cerr << "Cannot load RFF model " << model_file_name << endl;
+		classifier = rff;
+	}
+	else if (KNNClassifier::is_knn_file(model_file_name))
+	{
+		shared_ptr<KNNClassifier> knn = make_shared<KNNClassifier>(img_L);
+		if (!knn->load(model_file_name))
+			cerr << "Cannot load kNN model " << model_file_name << endl;
+		classifier = knn;
+	}
+	else
+		classifier = make_shared<SVMClassifier>(this, model_file_name);
+	init_feature_weight();
 }
 
 
@@ -34,9 +60,8 @@ double OCR::lbp_run(Mat &src, int thresh, double slope)
 	}
 	ARAN(ocr_img, ocr_img, img_L);
 
-	ERFilter erfilter;
-	Mat lbp = erfilter.calc_LBP(ocr_img);
-	vector<double> fv = erfilter.make_LBP_hist(lbp, 2, img_L);
+	Mat lbp = ERFilter::calc_LBP(ocr_img);
+	vector<double> fv = ERFilter::make_LBP_hist(lbp, 2, img_L);
 
 	svm_node *node = new svm_node[fv.size() + 1];
 
@@ -52,19 +77,33 @@ double OCR::lbp_run(Mat &src, int thresh, double slope)
 	}
 	node[j].index = -1;
 	
-	double *pv = new double[svm_get_nr_class(model)];
-	const int label = svm_predict_probability(model, node, pv);
-	const double prob = pv[label];
-	cout << table[label] << " Probability = " << pv[label] << endl;
+	// the LBP feature only makes sense for a SVM trained on it
+	SVMClassifier *svm = dynamic_cast<SVMClassifier*>(classifier.get());
+	if (svm == nullptr)
+	{
+		delete[] node;
+		return 0;
+	}
+
+	double prob;
+	const int label = svm->predict(node, prob);
+	cout << table[label] << " Probability = " << prob << endl;
 	
 	delete[] node;
-	delete[] pv;
 
 	return table[label] + prob;
 }
 
 
 double OCR::chain_run(Mat &src, int thresh, double slope)
+{
+	vector<double> top;
+	chain_top_k(src, thresh, 1, top, slope);
+	return top.front();
+}
+
+
+void OCR::chain_top_k(Mat &src, int thresh, const int k, vector<double> &top, double slope)
 {
 	Mat ocr_img;
 
@@ -78,69 +117,53 @@ double OCR::chain_run(Mat &src, int thresh, double slope)
 	}
 	ARAN(ocr_img, ocr_img, img_L);
 
+	//! identical glyph was recognized before, skip feature extraction and classification
+	unsigned long long key = 0;
+	if (cache)
+	{
+		key = OCRCache::make_key(ocr_img, slope, k);
+		if (cache->lookup(key, top))
+			return;
+	}
+
 	/*imshow("input", src);
 	imshow("rotated_ARAN", ocr_img);
 	moveWindow("input", 200, 400);
 	moveWindow("rotated_ARAN", 500, 400);*/
 
-	//! feature extract
-	svm_node *fv = new svm_node[8 * feature_L * feature_L + 1];
-	extract_feature(ocr_img, fv);
-	
 	//! classify
-	double *pv = new double[svm_get_nr_class(model)];
-	const int label = svm_predict_probability(model, fv, pv);
-	const double prob = pv[label];
+	vector<pair<int, double>> result;
+	classifier->predict_top(ocr_img, k, result);
 
-	//cout << table[label] << " Probability = " << pv[label] << endl;
-
-	/*Mat flann_feature = Mat::zeros(1, 8 * feature_L * feature_L, CV_32F);
-	float *ptr = flann_feature.ptr<float>(0);
-	int m = 0;
-	while (fv[m].index != -1)
-	{
-		ptr[fv[m].index] = fv[m].value;
-		m++;
-	}
-	vector<int> indice;
-	vector<float> dists;
-	index.knnSearch(flann_feature, indice, dists, 7, flann::SearchParams(64));
-	vector<char> neighbors;
-
-	for (int i = 0; i < indice.size(); i++)
-	{
-		neighbors.push_back(table[labels[indice[i]]]);
-	}
-	
-	sort(neighbors.begin(), neighbors.end(), [](char a, char b) {return a < b; });
-	int frequency = 0;
-	int max_frequency = 0;
-	char current_char = neighbors[0];
-	char most_frequency = neighbors[0];
-	for (int i = 0; i < neighbors.size(); i++)
-	{
-		if (neighbors[i] == current_char)
-			frequency++;
-		else if (frequency > max_frequency)
-		{
-			max_frequency = frequency;
-			most_frequency = current_char;
-		}
-	}
-	return most_frequency + max_frequency / 7.0;*/
-
-	delete[] fv;
-	delete[] pv;
+	// encode as letter + prob, prob has to stay below 1 or it would change the letter
+	top.resize(result.size());
+	for (int i = 0; i < result.size(); i++)
+		top[i] = table[result[i].first] + min(max(result[i].second, 0.0), 0.999);
 
 	/*waitKey(0);
 	destroyWindow("input");
 	destroyWindow("rotated_ARAN");*/
 
-	return table[label] + prob;
+	if (cache)
+		cache->insert(key, top);
 }
 
 
 
+void OCR::chain_feature(Mat &src, svm_node *fv)
+{
+	if (fused_feature)
+	{
+		static thread_local vector<float> dense;
+		dense.resize(8 * feature_L * feature_L);
+		extract_feature_fused(src, dense.data());
+		dense_to_svm_node(dense.data(), fv);
+	}
+	else
+		extract_feature(src, fv);
+}
+
+
 void OCR::extract_feature(Mat &src, svm_node *fv)
 {
 	/*imshow("src", src);
@@ -250,6 +273,248 @@ void OCR::extract_feature(Mat &src, svm_node *fv)
 }
 
 
+// Same feature as extract_feature without the 8 intermediate img_L x img_L images.
+// The boundary is followed with the border following algorithm of findContours
+// (S. Suzuki and K. Abe, "Topological structural analysis of digitized binary images by border following", 1985),
+// every (pixel, direction) sample is splatted straight into the feature_L x feature_L plane
+// of its direction with the precomputed blur + resize weights, then each plane is min-max normalized.
+// The result is not bit exact: extract_feature rounds to 8 bit after every step and normalizes
+// before resizing, see compare_chain_feature() for the difference on real glyphs.
+void OCR::extract_feature_fused(Mat &src, float *fv)
+{
+	// findContours treats the outermost ring of the image as background, so do we
+	// scratch buffers of the thread, chain_top_k runs in parallel on one OCR
+	static thread_local vector<schar> f;
+	static thread_local vector<uchar> marked;	// bit d set when the pixel is already in plane d
+
+	const int L = img_L;
+	const int F = feature_L * feature_L;
+	f.assign(L * L, 0);
+	for (int i = 1; i < L - 1; i++)
+	{
+		uchar* ptr = src.ptr<uchar>(i);
+		for (int j = 1; j < L - 1; j++)
+			f[i*L + j] = (ptr[j] != 0);
+	}
+
+	// chain code deltas in findContours order: right, up-right, up, ... counter-clockwise
+	const int delta[8] = { 1, 1 - L, -L, -1 - L, -1, L - 1, L, L + 1 };
+	const schar nbd = 2;
+
+	marked.assign(L * L, 0);
+	memset(fv, 0, sizeof(float) * 8 * F);
+
+	auto splat = [&](const int pixel, const int code)
+	{
+		// extract_feature uses chain_code_direction(next, current), which is mirrored to the contour code
+		const int dir = (4 - code) & 7;
+		if (marked[pixel] >> dir & 1)
+			return;
+		marked[pixel] |= 1 << dir;
+
+		const int x = pixel % L;
+		const int y = pixel / L;
+		float *plane = fv + dir * F;
+		for (int m = weight_begin[y]; m < weight_end[y]; m++)
+		{
+			const float wy = weight[y * feature_L + m];
+			for (int n = weight_begin[x]; n < weight_end[x]; n++)
+				plane[m * feature_L + n] += wy * weight[x * feature_L + n];
+		}
+	};
+
+	for (int i = 1; i < L - 1; i++)
+	{
+		schar prev = f[i*L];
+		for (int j = 1; j < L - 1; j++)
+		{
+			const schar p = f[i*L + j];
+			int origin;
+			int s;
+
+			if (prev == 0 && p == 1)			// outer border
+			{
+				origin = i*L + j;
+				s = 4;
+			}
+			else if (p == 0 && prev >= 1)		// hole border
+			{
+				origin = i*L + j - 1;
+				s = 0;
+			}
+			else
+			{
+				prev = p;
+				continue;
+			}
+
+			// search clockwise for the first non-zero neighbor
+			const int s_end = s;
+			int i1;
+			do
+			{
+				s = (s - 1) & 7;
+				i1 = origin + delta[s];
+			} while (f[i1] == 0 && s != s_end);
+
+			if (f[i1] == 0)
+			{
+				// isolated pixel, extract_feature skips contours with a single point
+				f[origin] = nbd | -128;
+			}
+			else
+			{
+				// follow the border counter-clockwise until we return to the origin
+				int i3 = origin;
+				for (;;)
+				{
+					const int s_start = s;
+					int i4;
+					for (;;)
+					{
+						s = (s + 1) & 7;
+						i4 = i3 + delta[s];
+						if (f[i4] != 0)
+							break;
+					}
+
+					if ((unsigned)(s - 1) < (unsigned)s_start)
+						f[i3] = nbd | -128;
+					else if (f[i3] == 1)
+						f[i3] = nbd;
+
+					splat(i3, s);
+
+					if (i4 == origin && i3 == i1)
+						break;
+
+					i3 = i4;
+					s = (s + 4) & 7;
+				}
+			}
+
+			prev = f[i*L + j];
+		}
+	}
+
+	// min-max normalize each direction plane
+	for (int d = 0; d < 8; d++)
+	{
+		float *plane = fv + d * F;
+		float min_v = FLT_MAX;
+		float max_v = -FLT_MAX;
+		for (int p = 0; p < F; p++)
+		{
+			min_v = min(min_v, plane[p]);
+			max_v = max(max_v, plane[p]);
+		}
+
+		const float scale = (max_v - min_v > FLT_EPSILON) ? 1.0f / (max_v - min_v) : 0;
+		for (int p = 0; p < F; p++)
+			plane[p] = (plane[p] - min_v) * scale;
+	}
+}
+
+
+// make the sparse svm feature out of a dense one, values that would be rounded to 0 in 8 bit are dropped
+int OCR::dense_to_svm_node(const float *dense, svm_node *fv)
+{
+	int j = 0;
+	for (int i = 0; i < 8 * feature_L * feature_L; i++)
+	{
+		if (dense[i] >= 0.5f / 255.0f)
+		{
+			fv[j].index = i;
+			fv[j].value = dense[i];
+			j++;
+		}
+	}
+	fv[j].index = -1;
+
+	return j;
+}
+
+
+// cached results come from the other feature path, drop them when it changes
+void OCR::set_fused_feature(bool fused)
+{
+	if (fused != fused_feature && cache)
+		cache->clear();
+	fused_feature = fused;
+}
+
+
+// the weights of GaussianBlur(Size(7, 7), 0) followed by resize() to feature_L are separable,
+// so one 1-D table of feature_L x img_L weights is enough. For each source coordinate only
+// the range [weight_begin, weight_end) of feature coordinates is non-zero.
+void OCR::init_feature_weight()
+{
+	const int ksize = 7;
+	const double sigma = 0.3 * ((ksize - 1) * 0.5 - 1) + 0.8;
+	double kernel[ksize];
+	double kernel_sum = 0;
+	for (int t = 0; t < ksize; t++)
+	{
+		const double x = t - ksize / 2;
+		kernel[t] = exp(-x*x / (2 * sigma*sigma));
+		kernel_sum += kernel[t];
+	}
+
+	// blur[r][c]: weight of source pixel c in blurred pixel r, with BORDER_REFLECT_101
+	vector<double> blur(img_L * img_L, 0);
+	for (int r = 0; r < img_L; r++)
+	{
+		for (int t = 0; t < ksize; t++)
+		{
+			int c = r + t - ksize / 2;
+			if (c < 0)
+				c = -c;
+			if (c >= img_L)
+				c = 2 * (img_L - 1) - c;
+			blur[r * img_L + c] += kernel[t] / kernel_sum;
+		}
+	}
+
+	// linear interpolation at the same sample position as resize()
+	const double scale = (double)img_L / feature_L;
+	weight.assign(img_L * feature_L, 0);
+	for (int i = 0; i < feature_L; i++)
+	{
+		const double fx = (i + 0.5) * scale - 0.5;
+		int x0 = floor(fx);
+		double alpha = fx - x0;
+		if (x0 < 0)
+		{
+			x0 = 0;
+			alpha = 0;
+		}
+		if (x0 >= img_L - 1)
+		{
+			x0 = img_L - 1;
+			alpha = 0;
+		}
+		const int x1 = min(x0 + 1, img_L - 1);
+
+		for (int c = 0; c < img_L; c++)
+			weight[c * feature_L + i] = (1 - alpha) * blur[x0 * img_L + c] + alpha * blur[x1 * img_L + c];
+	}
+
+	weight_begin.assign(img_L, feature_L);
+	weight_end.assign(img_L, 0);
+	for (int c = 0; c < img_L; c++)
+	{
+		for (int i = 0; i < feature_L; i++)
+		{
+			if (weight[c * feature_L + i] > 1e-6)
+			{
+				weight_begin[c] = min(weight_begin[c], i);
+				weight_end[c] = i + 1;
+			}
+		}
+	}
+}
+
+
 // Don't use this function any more
 void OCR::rotate_mat(Mat &src, Mat &dst, double rad, bool crop)
 {
@@ -586,11 +851,10 @@ void OCR::try_add_space(Text &text)
 	sort(dist.begin(), dist.end(), [](double a, double b) {return a < b; });
 	double median_x_dist = dist[dist.size()/2];
 
-	const double dist_thresh = 2.5;
 	for (int i = text.ers.size() - 2; i >= 0; i--)
 	{
 		double d = text.ers[i + 1]->bound.x - text.ers[i]->bound.br().x;
-		if (d > median_x_dist * dist_thresh && d > 0)
+		if (is_word_gap(d, median_x_dist))
 		{
 			text.word.insert(i + 1, " ");
 		}
@@ -598,6 +862,14 @@ void OCR::try_add_space(Text &text)
 }
 
 
+// median_dist is the median of the non-negative distances between the letters of the line
+bool OCR::is_word_gap(const double dist, const double median_dist)
+{
+	const double dist_thresh = 2.5;
+	return dist > median_dist * dist_thresh && dist > 0;
+}
+
+
 
 int OCR::chain_code_direction(Point p1, Point p2)
 {
@@ -635,4 +907,607 @@ int OCR::index_mapping(char c)
 		return 64;
 	else
 		return -1;
-}
\ No newline at end of file
+}
+
+void OCR::enable_cache(size_t capacity)
+{
+	cache = make_shared<OCRCache>(capacity);
+}
+
+OCRCache* OCR::get_cache()
+{
+	return cache.get();
+}
+
+// cached results come from the old backend, drop them
+void OCR::set_classifier(shared_ptr<OCRClassifier> _classifier)
+{
+	classifier = _classifier;
+	if (cache)
+		cache->clear();
+}
+
+OCRClassifier* OCR::get_classifier()
+{
+	return classifier.get();
+}
+
+int OCR::get_img_L()
+{
+	return img_L;
+}
+
+int OCR::get_feature_dim()
+{
+	return 8 * feature_L * feature_L;
+}
+
+
+// ==================================================
+// ================== OCRClassifier =================
+// ==================================================
+int OCRClassifier::predict(Mat &glyph, double &prob)
+{
+	vector<pair<int, double>> top;
+	predict_top(glyph, 1, top);
+	prob = top.front().second;
+	return top.front().first;
+}
+
+
+// the k highest scores of score[0] ~ score[n-1] as (index, score), highest first
+void OCRClassifier::select_top(const double *score, const int n, const int k, vector<pair<int, double>> &top)
+{
+	const int K = max(1, min(k, n));
+	vector<int> idx(n);
+	iota(idx.begin(), idx.end(), 0);
+	partial_sort(idx.begin(), idx.begin() + K, idx.end(), [score](int a, int b) { return score[a] > score[b]; });
+
+	top.resize(K);
+	for (int i = 0; i < K; i++)
+		top[i] = pair<int, double>(idx[i], score[idx[i]]);
+}
+
+
+// ==================================================
+// ================== SVMClassifier =================
+// ==================================================
+SVMClassifier::SVMClassifier(OCR *_ocr, const char *svm_file_name) : ocr(_ocr)
+{
+	model = svm_load_model(svm_file_name);
+}
+
+
+SVMClassifier::~SVMClassifier()
+{
+	if (model != nullptr)
+		svm_free_and_destroy_model(&model);
+}
+
+
+void SVMClassifier::predict_top(Mat &glyph, const int k, vector<pair<int, double>> &top)
+{
+	svm_node *fv = new svm_node[ocr->get_feature_dim() + 1];
+	ocr->chain_feature(glyph, fv);
+	predict_top(fv, k, top);
+	delete[] fv;
+}
+
+
+void SVMClassifier::predict_top(svm_node *fv, const int k, vector<pair<int, double>> &top)
+{
+	vector<double> prob;
+	predict_prob(fv, prob);
+	select_top(prob.data(), prob.size(), k, top);
+}
+
+
+int SVMClassifier::predict(svm_node *fv, double &prob)
+{
+	double *pv = new double[svm_get_nr_class(model)];
+	const int label = svm_predict_probability(model, fv, pv);
+	prob = pv[label];
+	delete[] pv;
+	return label;
+}
+
+
+void SVMClassifier::predict_prob(svm_node *fv, vector<double> &prob)
+{
+	prob.resize(svm_get_nr_class(model));
+	svm_predict_probability(model, fv, prob.data());
+}
+
+
+svm_model* SVMClassifier::get_model()
+{
+	return model;
+}
+
+
+// ==================================================
+// ================== RFFClassifier =================
+// ==================================================
+RFFClassifier::RFFClassifier(OCR *_ocr) : ocr(_ocr), feature_dim(0), map_dim(0), class_num(0)
+{
+}
+
+
+bool RFFClassifier::is_rff_file(const char *filename)
+{
+	fstream fin(filename, fstream::in | fstream::binary);
+	char magic[4] = { 0 };
+	fin.read(magic, 4);
+	return fin && magic[0] == 'R' && magic[1] == 'F' && magic[2] == 'F' && magic[3] == '1';
+}
+
+
+// file layout: "RFF1", feature_dim, map_dim, class_num, W, b, A, c (all binary)
+bool RFFClassifier::load(const char *filename)
+{
+	fstream fin(filename, fstream::in | fstream::binary);
+	char magic[4];
+	fin.read(magic, 4);
+	fin.read((char*)&feature_dim, sizeof(int));
+	fin.read((char*)&map_dim, sizeof(int));
+	fin.read((char*)&class_num, sizeof(int));
+	if (!fin || feature_dim <= 0 || map_dim <= 0 || class_num <= 0)
+		return false;
+
+	W.resize((size_t)feature_dim * map_dim);
+	b.resize(map_dim);
+	A.resize((size_t)class_num * map_dim);
+	c.resize(class_num);
+	fin.read((char*)W.data(), sizeof(float) * W.size());
+	fin.read((char*)b.data(), sizeof(float) * b.size());
+	fin.read((char*)A.data(), sizeof(float) * A.size());
+	fin.read((char*)c.data(), sizeof(float) * c.size());
+
+	return !fin.fail();
+}
+
+
+bool RFFClassifier::save(const char *filename)
+{
+	fstream fout(filename, fstream::out | fstream::binary);
+	if (!fout.is_open())
+		return false;
+
+	fout.write("RFF1", 4);
+	fout.write((char*)&feature_dim, sizeof(int));
+	fout.write((char*)&map_dim, sizeof(int));
+	fout.write((char*)&class_num, sizeof(int));
+	fout.write((char*)W.data(), sizeof(float) * W.size());
+	fout.write((char*)b.data(), sizeof(float) * b.size());
+	fout.write((char*)A.data(), sizeof(float) * A.size());
+	fout.write((char*)c.data(), sizeof(float) * c.size());
+
+	return !fout.fail();
+}
+
+
+// X is N x feature_dim dense features (CV_32F), P is N x class_num SVM probabilities (CV_32F).
+// z(x) = sqrt(2/D) cos(Wx + b) with W ~ N(0, 2 gamma) approximates exp(-gamma |x-y|^2),
+// the linear model on z is solved by ridge regression to P.
+void RFFClassifier::fit(Mat &X, Mat &P, const double gamma, const int D, const double lambda, const unsigned long long seed)
+{
+	feature_dim = X.cols;
+	map_dim = D;
+	class_num = P.cols;
+
+	RNG rng(seed);
+	W.resize((size_t)feature_dim * map_dim);
+	b.resize(map_dim);
+	const double sigma = sqrt(2 * gamma);
+	for (size_t i = 0; i < W.size(); i++)
+		W[i] = rng.gaussian(sigma);
+	for (int i = 0; i < map_dim; i++)
+		b[i] = rng.uniform(0.0, 2 * CV_PI);
+
+	// map every sample, the last column is the bias
+	const float scale = sqrt(2.0 / map_dim);
+	Mat Z(X.rows, map_dim + 1, CV_32F);
+#pragma omp parallel for
+	for (int n = 0; n < X.rows; n++)
+	{
+		const float *x = X.ptr<float>(n);
+		float *z = Z.ptr<float>(n);
+		memcpy(z, b.data(), sizeof(float) * map_dim);
+		for (int i = 0; i < feature_dim; i++)
+		{
+			if (x[i] == 0)
+				continue;
+			const float *w = &W[(size_t)i * map_dim];
+			for (int d = 0; d < map_dim; d++)
+				z[d] += x[i] * w[d];
+		}
+		for (int d = 0; d < map_dim; d++)
+			z[d] = scale * cos(z[d]);
+		z[map_dim] = 1;
+	}
+
+	Mat ZtZ, ZtP, solution;
+	mulTransposed(Z, ZtZ, true, noArray(), 1, CV_64F);
+	gemm(Z, P, 1, noArray(), 0, ZtP, GEMM_1_T);
+	ZtP.convertTo(ZtP, CV_64F);
+	for (int d = 0; d < map_dim; d++)
+		ZtZ.at<double>(d, d) += lambda * X.rows;
+	solve(ZtZ, ZtP, solution, DECOMP_CHOLESKY);
+
+	A.resize((size_t)class_num * map_dim);
+	c.resize(class_num);
+	for (int k = 0; k < class_num; k++)
+	{
+		for (int d = 0; d < map_dim; d++)
+			A[(size_t)k * map_dim + d] = solution.at<double>(d, k);
+		c[k] = solution.at<double>(map_dim, k);
+	}
+}
+
+
+void RFFClassifier::predict_top(Mat &glyph, const int k, vector<pair<int, double>> &top)
+{
+	svm_node *fv = new svm_node[ocr->get_feature_dim() + 1];
+	ocr->chain_feature(glyph, fv);
+	predict_top(fv, k, top);
+	delete[] fv;
+}
+
+
+void RFFClassifier::predict_top(svm_node *fv, const int k, vector<pair<int, double>> &top)
+{
+	// the chain-code feature is sparse, accumulate the projection row of every non-zero entry
+	vector<float> z(b);
+	for (int m = 0; fv[m].index != -1; m++)
+	{
+		if (fv[m].index >= feature_dim)
+			continue;
+		const float x = fv[m].value;
+		const float *w = &W[(size_t)fv[m].index * map_dim];
+		for (int d = 0; d < map_dim; d++)
+			z[d] += x * w[d];
+	}
+
+	const float scale = sqrt(2.0 / map_dim);
+	for (int d = 0; d < map_dim; d++)
+		z[d] = scale * cos(z[d]);
+
+	// the regression target is the SVM probability, the score is used as the probability directly
+	vector<double> score(class_num);
+	for (int n = 0; n < class_num; n++)
+	{
+		const float *a = &A[(size_t)n * map_dim];
+		float sum = c[n];
+		for (int d = 0; d < map_dim; d++)
+			sum += a[d] * z[d];
+		score[n] = sum;
+	}
+
+	select_top(score.data(), class_num, k, top);
+}
+
+
+int RFFClassifier::predict(svm_node *fv, double &prob)
+{
+	vector<pair<int, double>> top;
+	predict_top(fv, 1, top);
+	prob = top.front().second;
+	return top.front().first;
+}
+
+
+int RFFClassifier::get_map_dim()
+{
+	return map_dim;
+}
+
+
+// ==================================================
+// ================== KNNClassifier =================
+// ==================================================
+KNNClassifier::KNNClassifier(int _img_L, int _k) : img_L(_img_L), k(_k)
+{
+	words = (img_L * img_L + 63) / 64;
+	words = (words + 3) / 4 * 4;
+}
+
+
+bool KNNClassifier::is_knn_file(const char *filename)
+{
+	fstream fin(filename, fstream::in | fstream::binary);
+	char magic[4] = { 0 };
+	fin.read(magic, 4);
+	return fin && magic[0] == 'K' && magic[1] == 'N' && magic[2] == 'N' && magic[3] == '1';
+}
+
+
+// file layout: "KNN1", img_L, words, sample number, labels, descriptors (all binary)
+bool KNNClassifier::load(const char *filename)
+{
+	fstream fin(filename, fstream::in | fstream::binary);
+	if (!fin.is_open())
+		return false;
+
+	char magic[4];
+	int L, w, n;
+	fin.read(magic, 4);
+	fin.read((char*)&L, sizeof(int));
+	fin.read((char*)&w, sizeof(int));
+	fin.read((char*)&n, sizeof(int));
+	if (!fin || magic[0] != 'K' || magic[1] != 'N' || magic[2] != 'N' || magic[3] != '1' || L != img_L || w != words || n < 0)
+		return false;
+
+	// the samples must fit in the rest of the file, a bad count fails before anything is allocated
+	const long long header_size = fin.tellg();
+	fin.seekg(0, fstream::end);
+	const long long length = fin.tellg();
+	fin.seekg(header_size, fstream::beg);
+	if ((length - header_size) / (long long)(sizeof(int) + sizeof(unsigned long long) * words) < n)
+		return false;
+
+	labels.resize(n);
+	descriptors.resize((size_t)n * words);
+	fin.read((char*)labels.data(), sizeof(int) * n);
+	fin.read((char*)descriptors.data(), sizeof(unsigned long long) * descriptors.size());
+
+	// predict_top votes in an array of the 65 OCR labels, a rejected file leaves no sample
+	bool valid = !fin.fail();
+	for (int i = 0; valid && i < n; i++)
+		valid = (labels[i] >= 0 && labels[i] < 65);
+	if (!valid)
+	{
+		labels.clear();
+		descriptors.clear();
+	}
+	return valid;
+}
+
+
+bool KNNClassifier::save(const char *filename)
+{
+	fstream fout(filename, fstream::out | fstream::binary);
+	if (!fout.is_open())
+		return false;
+
+	const int n = labels.size();
+	fout.write("KNN1", 4);
+	fout.write((char*)&img_L, sizeof(int));
+	fout.write((char*)&words, sizeof(int));
+	fout.write((char*)&n, sizeof(int));
+	fout.write((char*)labels.data(), sizeof(int) * n);
+	fout.write((char*)descriptors.data(), sizeof(unsigned long long) * descriptors.size());
+
+	return !fout.fail();
+}
+
+
+void KNNClassifier::add_sample(Mat &glyph, int label)
+{
+	descriptors.resize(descriptors.size() + words);
+	pack(glyph, &descriptors[descriptors.size() - words]);
+	labels.push_back(label);
+}
+
+
+size_t KNNClassifier::size()
+{
+	return labels.size();
+}
+
+
+void KNNClassifier::predict_top(Mat &glyph, const int n, vector<pair<int, double>> &top)
+{
+	if (labels.empty())
+	{
+		top.assign(1, pair<int, double>(0, 0.0));
+		return;
+	}
+
+	vector<unsigned long long> query(words);
+	pack(glyph, query.data());
+
+	// keep the k nearest samples sorted by distance
+	const int K = min<int>(k, labels.size());
+	vector<pair<int, int>> nearest(K, pair<int, int>(INT_MAX, 0));
+	for (int i = 0; i < labels.size(); i++)
+	{
+		const int dist = hamming_distance(query.data(), &descriptors[(size_t)i * words], words);
+		if (dist >= nearest.back().first)
+			continue;
+
+		int j = K - 1;
+		while (j > 0 && nearest[j - 1].first > dist)
+		{
+			nearest[j] = nearest[j - 1];
+			j--;
+		}
+		nearest[j] = pair<int, int>(dist, labels[i]);
+	}
+
+	// distance weighted vote
+	double vote[65] = { 0 };
+	double total = 0;
+	for (int i = 0; i < K; i++)
+	{
+		const double w = 1.0 / (1.0 + nearest[i].first);
+		vote[nearest[i].second] += w;
+		total += w;
+	}
+	for (int i = 0; i < 65; i++)
+		vote[i] /= total;
+
+	select_top(vote, 65, n, top);
+}
+
+
+int KNNClassifier::hamming_distance(const unsigned long long *a, const unsigned long long *b, const int words)
+{
+#ifdef __AVX2__
+	// popcount of every nibble by table lookup, summed per 64-bit lane by sad
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+											0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc = zero;
+	for (int i = 0; i < words; i += 4)
+	{
+		const __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+		const __m256i lo = _mm256_and_si256(x, low_mask);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+		const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, zero));
+	}
+	return _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#else
+	int dist = 0;
+	for (int i = 0; i < words; i++)
+		dist += POPCOUNT64(a[i] ^ b[i]);
+	return dist;
+#endif
+}
+
+
+// 1 bit per pixel in row major order, the padding bits stay zero
+void KNNClassifier::pack(Mat &glyph, unsigned long long *dst)
+{
+	memset(dst, 0, sizeof(unsigned long long) * words);
+
+	int n = 0;
+	for (int i = 0; i < img_L; i++)
+	{
+		uchar* ptr = glyph.ptr<uchar>(i);
+		for (int j = 0; j < img_L; j++, n++)
+		{
+			if (ptr[j] != 0)
+				dst[n >> 6] |= 1ULL << (n & 63);
+		}
+	}
+}
+
+
+OCRCache::OCRCache(size_t capacity, int shard_num) : shard_capacity(max<size_t>(1, capacity / shard_num))
+{
+	for (int i = 0; i < shard_num; i++)
+		shards.push_back(unique_ptr<Shard>(new Shard()));
+}
+
+
+bool OCRCache::lookup(const unsigned long long key, vector<double> &result)
+{
+	Shard &shard = *shards[key % shards.size()];
+	lock_guard<mutex> guard(shard.lock);
+
+	auto it = shard.table.find(key);
+	if (it == shard.table.end())
+	{
+		shard.misses++;
+		return false;
+	}
+
+	// move the entry to the front, it is the most recently used one now
+	shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+	result = it->second->second;
+	shard.hits++;
+	return true;
+}
+
+
+void OCRCache::insert(const unsigned long long key, const vector<double> &result)
+{
+	Shard &shard = *shards[key % shards.size()];
+	lock_guard<mutex> guard(shard.lock);
+
+	auto it = shard.table.find(key);
+	if (it != shard.table.end())
+	{
+		it->second->second = result;
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		return;
+	}
+
+	shard.lru.push_front(make_pair(key, result));
+	shard.table[key] = shard.lru.begin();
+
+	if (shard.lru.size() > shard_capacity)
+	{
+		shard.table.erase(shard.lru.back().first);
+		shard.lru.pop_back();
+	}
+}
+
+
+void OCRCache::clear()
+{
+	for (auto &it : shards)
+	{
+		lock_guard<mutex> guard(it->lock);
+		it->lru.clear();
+		it->table.clear();
+		it->hits = 0;
+		it->misses = 0;
+	}
+}
+
+
+unsigned long long OCRCache::get_hits()
+{
+	unsigned long long hits = 0;
+	for (auto &it : shards)
+	{
+		lock_guard<mutex> guard(it->lock);
+		hits += it->hits;
+	}
+	return hits;
+}
+
+
+unsigned long long OCRCache::get_misses()
+{
+	unsigned long long misses = 0;
+	for (auto &it : shards)
+	{
+		lock_guard<mutex> guard(it->lock);
+		misses += it->misses;
+	}
+	return misses;
+}
+
+
+double OCRCache::hit_rate()
+{
+	const unsigned long long hits = get_hits();
+	const unsigned long long misses = get_misses();
+	return (hits + misses) ? (double)hits / (hits + misses) : 0;
+}
+
+
+// FNV-1a over the glyph packed to 1 bit per pixel, followed by the slope in degrees and
+// the number of requested results.
+// extract_feature only looks at whether a pixel is zero or not, so glyphs with the
+// same key always produce the same feature vector.
+unsigned long long OCRCache::make_key(Mat &glyph, double slope, const int k)
+{
+	const unsigned long long prime = 1099511628211ULL;
+	unsigned long long hash = 14695981039346656037ULL;
+
+	for (int i = 0; i < glyph.rows; i++)
+	{
+		uchar* ptr = glyph.ptr<uchar>(i);
+		uchar bits = 0;
+		for (int j = 0; j < glyph.cols; j++)
+		{
+			bits = (bits << 1) | (ptr[j] != 0);
+			if ((j & 7) == 7 || j == glyph.cols - 1)
+			{
+				hash = (hash ^ bits) * prime;
+				bits = 0;
+			}
+		}
+	}
+
+	const int slope_bucket = cvRound(atan(slope) * 180 / CV_PI);
+	hash = (hash ^ (unsigned)slope_bucket) * prime;
+	hash = (hash ^ (unsigned)k) * prime;
+
+	return hash;
+}
@@ -0,0 +1,302 @@
+#include "../inc/Profiler.h"
+
+#include <map>
+#include <algorithm>
+
+
+// ====================================================
+// ===================== Stopwatch ====================
+// ====================================================
+Profiler::record::record(std::string _name, long long _duration) : name(_name), duration(_duration), value(0), is_msg(false)
+{
+}
+
+
+Profiler::record::record(std::string _name, float _value, bool _is_msg) : name(_name), duration(0), value(_value), is_msg(_is_msg)
+{
+}
+
+
+Profiler::Profiler() : count(0)
+{
+	time = std::chrono::steady_clock::now();
+}
+
+
+void Profiler::Start()
+{
+	time = std::chrono::steady_clock::now();
+}
+
+
+// number of laps logged since the last Report
+int Profiler::Count()
+{
+	return count;
+}
+
+
+// seconds since Start or the last Log
+double Profiler::Stop()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count();
+}
+
+
+// lap timer, logs the time since Start or the last Log and starts the next lap
+void Profiler::Log(std::string name)
+{
+	const auto now = std::chrono::steady_clock::now();
+	logs.push(record(name, std::chrono::duration_cast<std::chrono::microseconds>(now - time).count()));
+	time = now;
+	++count;
+}
+
+
+void Profiler::Message(std::string msg, float value)
+{
+	logs.push(record(msg, value, true));
+}
+
+
+void Profiler::Report()
+{
+	while (!logs.empty())
+	{
+		const record &r = logs.front();
+		if (r.is_msg)
+			std::cout << r.name << ": " << r.value << "\n";
+		else
+			std::cout << r.name << ": " << r.duration / 1000.0 << "ms\n";
+		logs.pop();
+	}
+	std::cout << endl;
+	count = 0;
+}
+
+
+// ====================================================
+// ====================== Tracing =====================
+// ====================================================
+atomic<bool> Profiler::enabled(false);
+atomic<unsigned long long> Profiler::frame_count(0);
+mutex Profiler::registry_lock;
+vector<unique_ptr<Profiler::ThreadBuffer>> Profiler::buffers;
+fstream Profiler::metrics_out;
+int Profiler::metrics_period = 0;
+long long Profiler::metrics_counter[COUNT_NUM] = {};
+long long Profiler::metrics_time = 0;
+
+static const char *counter_name[COUNT_NUM] = { "tree_node", "pool", "strong", "weak", "tracked", "group", "character" };
+
+
+void Profiler::enable(bool on)
+{
+	enabled.store(on);
+}
+
+
+long long Profiler::now_us()
+{
+	static const auto epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+
+Profiler::ThreadBuffer* Profiler::thread_buffer()
+{
+	thread_local ThreadBuffer *buffer = nullptr;
+	if (buffer == nullptr)
+	{
+		lock_guard<mutex> guard(registry_lock);
+		buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+		buffer = buffers.back().get();
+		buffer->tid = buffers.size();
+		buffer->dumped = 0;
+		buffer->dropped = 0;
+		fill_n(buffer->counter, COUNT_NUM, 0);
+	}
+	return buffer;
+}
+
+
+void Profiler::record_span(const char *name, int channel, long long begin, long long end)
+{
+	ThreadBuffer *buffer = thread_buffer();
+	lock_guard<mutex> guard(buffer->lock);
+	if (buffer->events.size() < MAX_EVENT)
+		buffer->events.push_back({ name, channel, begin, end });
+	else
+		++buffer->dropped;
+}
+
+
+void Profiler::record_count(ProfileCounter counter, long long n)
+{
+	ThreadBuffer *buffer = thread_buffer();
+	lock_guard<mutex> guard(buffer->lock);
+	buffer->counter[counter] += n;
+}
+
+
+// called at the end of every text_detect, from any thread
+void Profiler::frame_end()
+{
+	if (!is_enabled())
+		return;
+
+	const unsigned long long n = ++frame_count;
+	if (metrics_period > 0 && n % metrics_period == 0)
+		dump_metrics();
+}
+
+
+// one tab separated line every period frames: the frame count, the frame rate and per frame means
+// of the counters and the spans of the window since the last line
+void Profiler::set_metrics_dump(const string &filename, int period)
+{
+	lock_guard<mutex> guard(registry_lock);
+	if (metrics_out.is_open())
+		metrics_out.close();
+	metrics_period = 0;
+	if (period <= 0)
+		return;
+
+	metrics_out.open(filename, fstream::out);
+	if (!metrics_out.is_open())
+		return;
+	metrics_period = period;
+	metrics_time = now_us();
+}
+
+
+void Profiler::dump_metrics()
+{
+	lock_guard<mutex> guard(registry_lock);
+	if (!metrics_out.is_open())
+		return;
+
+	long long counter[COUNT_NUM] = {};
+	map<string, pair<double, int>> span;		// name -> total seconds, count
+	for (auto &it : buffers)
+	{
+		lock_guard<mutex> buffer_guard(it->lock);
+		for (int c = 0; c < COUNT_NUM; c++)
+			counter[c] += it->counter[c];
+		for (size_t i = it->dumped; i < it->events.size(); i++)
+		{
+			auto &s = span[it->events[i].name];
+			s.first += (it->events[i].end - it->events[i].begin) * 1e-6;
+			++s.second;
+		}
+		it->dumped = it->events.size();
+	}
+
+	const long long now = now_us();
+	metrics_out << "frame=" << frame_count.load() << "\tfps=" << metrics_period / max(1e-6, (now - metrics_time) * 1e-6);
+	for (int c = 0; c < COUNT_NUM; c++)
+	{
+		metrics_out << "\t" << counter_name[c] << "=" << (double)(counter[c] - metrics_counter[c]) / metrics_period;
+		metrics_counter[c] = counter[c];
+	}
+	for (auto &it : span)
+		metrics_out << "\t" << it.first << "_ms=" << it.second.first * 1000 / metrics_period;
+	metrics_out << endl;
+	metrics_time = now;
+}
+
+
+// Chrome trace event format, complete events ("ph":"X") with the channel as argument
+bool Profiler::write_chrome_trace(const string &filename)
+{
+	fstream fout(filename, fstream::out);
+	if (!fout.is_open())
+		return false;
+
+	lock_guard<mutex> guard(registry_lock);
+	fout << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (auto &it : buffers)
+	{
+		lock_guard<mutex> buffer_guard(it->lock);
+		for (auto &e : it->events)
+		{
+			fout << (first ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"cat\":\"text_detect\",\"ph\":\"X\",\"pid\":1,\"tid\":" << it->tid
+				<< ",\"ts\":" << e.begin << ",\"dur\":" << e.end - e.begin;
+			if (e.channel >= 0)
+				fout << ",\"args\":{\"channel\":" << e.channel << "}";
+			fout << "}";
+			first = false;
+		}
+	}
+	fout << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return true;
+}
+
+
+// p50/p95/p99 of every span name over the whole run, and the counters per frame
+void Profiler::report_latency(ostream &out)
+{
+	lock_guard<mutex> guard(registry_lock);
+	map<string, vector<double>> span;
+	long long counter[COUNT_NUM] = {};
+	unsigned long long dropped = 0;
+	for (auto &it : buffers)
+	{
+		lock_guard<mutex> buffer_guard(it->lock);
+		for (auto &e : it->events)
+			span[e.name].push_back((e.end - e.begin) * 1e-3);
+		for (int c = 0; c < COUNT_NUM; c++)
+			counter[c] += it->counter[c];
+		dropped += it->dropped;
+	}
+
+	const unsigned long long frames = max<unsigned long long>(1, frame_count.load());
+	out << "Frames traced: " << frame_count.load() << (dropped ? ", spans dropped: " : "");
+	if (dropped)
+		out << dropped;
+	out << "\n";
+	for (auto &it : span)
+	{
+		vector<double> &t = it.second;
+		sort(t.begin(), t.end());
+		auto percentile = [&](double p) { return t[min<size_t>(t.size() - 1, t.size() * p)]; };
+		out << it.first << ": n = " << t.size() << ", p50 = " << percentile(0.5) << "ms, p95 = " << percentile(0.95)
+			<< "ms, p99 = " << percentile(0.99) << "ms, max = " << t.back() << "ms\n";
+	}
+	for (int c = 0; c < COUNT_NUM; c++)
+		out << counter_name[c] << " = " << (double)counter[c] / frames << " per frame\n";
+	out << endl;
+}
+
+
+void Profiler::clear()
+{
+	lock_guard<mutex> guard(registry_lock);
+	for (auto &it : buffers)
+	{
+		lock_guard<mutex> buffer_guard(it->lock);
+		it->events.clear();
+		it->dumped = 0;
+		it->dropped = 0;
+		fill_n(it->counter, COUNT_NUM, 0);
+	}
+	frame_count = 0;
+	fill_n(metrics_counter, COUNT_NUM, 0);
+	metrics_time = now_us();
+}
+
+
+void Profiler::print_stage_time(ostream &out, const vector<double> &total_time, int frame_num)
+{
+	if (total_time.size() < 7 || frame_num <= 0)
+		return;
+
+	out << "ER extraction = " << total_time[0] * 1000 / frame_num << "ms\n"
+		<< "Non-maximum suppression = " << total_time[1] * 1000 / frame_num << "ms\n"
+		<< "Classification = " << total_time[2] * 1000 / frame_num << "ms\n"
+		<< "Character tracking = " << total_time[3] * 1000 / frame_num << "ms\n"
+		<< "Character grouping = " << total_time[4] * 1000 / frame_num << "ms\n"
+		<< "OCR = " << total_time[5] * 1000 / frame_num << "ms\n"
+		<< "Total execution time = " << total_time[6] * 1000 / frame_num << "ms\n";
+}
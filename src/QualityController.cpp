@@ -0,0 +1,169 @@
+#include "../inc/QualityController.h"
+
+
+// channels of ERFilter::compute_channels: Y, Cr, Cb and their inverses, the luminance pair (0x09) finds most text
+const QualityController::DetectLevel QualityController::DETECT_LADDER[] = {
+	{ 1, 1, 0x3F },
+	{ 1, 2, 0x3F },
+	{ 2, 2, 0x3F },
+	{ 2, 2, 0x09 },
+	{ 3, 4, 0x09 }
+};
+const int QualityController::OCR_LADDER[] = { -1, 8, 4, 2, 1, 0 };
+const int QualityController::DETECT_LEVEL_NUM = sizeof(DETECT_LADDER) / sizeof(DETECT_LADDER[0]);
+const int QualityController::OCR_LEVEL_NUM = sizeof(OCR_LADDER) / sizeof(OCR_LADDER[0]);
+const double QualityController::SPIKE_RATIO = 2.0;
+const double QualityController::ALPHA = 0.2;
+
+
+QualityController::QualityController(ERFilter *_er_filter, double target_ms, int base_thresh_step, int base_min_area, double low_ratio, int hold_frames) :
+									er_filter(_er_filter), TARGET_MS(target_ms), BASE_THRESH_STEP(base_thresh_step), BASE_MIN_AREA(base_min_area),
+									LOW_RATIO(low_ratio), HOLD_FRAMES(max(1, hold_frames))
+{
+	reset();
+}
+
+
+// back to the full quality
+void QualityController::reset()
+{
+	detect_level = 0;
+	ocr_level = 0;
+	history.clear();
+	cost_ema = 0;
+	ocr_ema = 0;
+	since_change = 0;
+	under_count = 0;
+	hold = HOLD_FRAMES;
+	last_step_up = false;
+	overrun_count = 0;
+	change_count = 0;
+	apply();
+}
+
+
+void QualityController::set_target(double target_ms)
+{
+	TARGET_MS = target_ms;
+	under_count = 0;
+}
+
+
+int QualityController::get_detect_level()
+{
+	return detect_level;
+}
+
+
+int QualityController::get_ocr_level()
+{
+	return ocr_level;
+}
+
+
+double QualityController::get_cost()
+{
+	return cost_ema;
+}
+
+
+unsigned long long QualityController::get_overrun_count()
+{
+	return overrun_count;
+}
+
+
+unsigned long long QualityController::get_change_count()
+{
+	return change_count;
+}
+
+
+void QualityController::update(const vector<double> &times)
+{
+	if (times.size() < 7)
+		return;
+
+	// times[6] is the whole text_detect, times[5] the OCR
+	const double cost = times[6] * 1000;
+	const double ocr = times[5] * 1000;
+
+	// the running means start again at every change, frames of the old levels say nothing about the new ones
+	if (since_change == 0)
+	{
+		cost_ema = cost;
+		ocr_ema = ocr;
+	}
+	else
+	{
+		cost_ema = ALPHA * cost + (1 - ALPHA) * cost_ema;
+		ocr_ema = ALPHA * ocr + (1 - ALPHA) * ocr_ema;
+	}
+	++since_change;
+
+	if (cost > TARGET_MS)
+		++overrun_count;
+	under_count = (cost < LOW_RATIO * TARGET_MS) ? under_count + 1 : 0;
+
+	if (cost > SPIKE_RATIO * TARGET_MS || (since_change >= MIN_DWELL && cost_ema > TARGET_MS))
+		step_down(ocr_ema > cost_ema - ocr_ema);
+	else if (since_change >= hold && under_count >= hold)
+		step_up();
+}
+
+
+// the ladder of the dominant stage first, the other one when it is exhausted
+void QualityController::step_down(bool ocr_dominates)
+{
+	const bool can_detect = detect_level < DETECT_LEVEL_NUM - 1;
+	const bool can_ocr = ocr_level < OCR_LEVEL_NUM - 1;
+	if (!can_detect && !can_ocr)
+		return;
+
+	const bool use_ocr = can_ocr && (ocr_dominates || !can_detect);
+	if (use_ocr)
+		++ocr_level;
+	else
+		++detect_level;
+	history.push_back(use_ocr);
+
+	// a step up that did not hold is retried later and later, so a cost right at the target
+	// does not toggle between two levels
+	if (last_step_up && since_change < hold)
+		hold = min(hold * 2, HOLD_FRAMES * 8);
+	last_step_up = false;
+
+	since_change = 0;
+	under_count = 0;
+	++change_count;
+	apply();
+}
+
+
+void QualityController::step_up()
+{
+	if (history.empty())
+		return;
+
+	if (history.back())
+		--ocr_level;
+	else
+		--detect_level;
+	history.pop_back();
+
+	last_step_up = true;
+	since_change = 0;
+	under_count = 0;
+	++change_count;
+	apply();
+}
+
+
+void QualityController::apply()
+{
+	const DetectLevel &level = DETECT_LADDER[detect_level];
+	er_filter->set_thresh_step(BASE_THRESH_STEP * level.thresh_step);
+	er_filter->set_min_area(BASE_MIN_AREA * level.min_area);
+	er_filter->set_channel_mask(level.channel_mask);
+	er_filter->set_ocr_max_line(OCR_LADDER[ocr_level]);
+}
@@ -0,0 +1,180 @@
+#include "../inc/ResultSink.h"
+
+
+// ====================================================
+// =================== JsonLinesSink ==================
+// ====================================================
+JsonLinesSink::JsonLinesSink(const string &filename)
+{
+	fout.open(filename, fstream::out);
+}
+
+
+void JsonLinesSink::write(const ResultRecord &record)
+{
+	fout << "{\"source\":";
+	write_string(fout, record.source);
+	fout << ",\"index\":" << record.index;
+	if (!record.times.empty())
+		fout << ",\"time_ms\":" << record.times.back() * 1000;
+	fout << ",\"text\":[";
+	for (int i = 0; i < record.text.size(); i++)
+	{
+		const TextResult &it = record.text[i];
+		if (i > 0)
+			fout << ',';
+		fout << "{\"word\":";
+		write_string(fout, it.word);
+		fout << ",\"box\":[" << it.box.x << ',' << it.box.y << ',' << it.box.width << ',' << it.box.height << ']'
+			<< ",\"slope\":" << it.slope << '}';
+	}
+	fout << "]}\n";
+}
+
+
+void JsonLinesSink::flush()
+{
+	fout.flush();
+}
+
+
+bool JsonLinesSink::is_open()
+{
+	return fout.is_open();
+}
+
+
+void JsonLinesSink::write_string(ostream &out, const string &s)
+{
+	out << '"';
+	for (auto c : s)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+		{
+			char buf[8];
+			sprintf(buf, "\\u%04x", (unsigned char)c);
+			out << buf;
+		}
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+
+// ====================================================
+// ====================== CsvSink =====================
+// ====================================================
+CsvSink::CsvSink(const string &filename)
+{
+	fout.open(filename, fstream::out);
+	fout << "source,index,word,x,y,width,height,slope\n";
+}
+
+
+void CsvSink::write(const ResultRecord &record)
+{
+	for (auto &it : record.text)
+	{
+		write_field(fout, record.source);
+		fout << ',' << record.index << ',';
+		write_field(fout, it.word);
+		fout << ',' << it.box.x << ',' << it.box.y << ',' << it.box.width << ',' << it.box.height << ',' << it.slope << '\n';
+	}
+}
+
+
+void CsvSink::flush()
+{
+	fout.flush();
+}
+
+
+bool CsvSink::is_open()
+{
+	return fout.is_open();
+}
+
+
+// RFC 4180, a field with a comma, quote or line break is quoted and its quotes doubled
+void CsvSink::write_field(ostream &out, const string &s)
+{
+	if (s.find_first_of(",\"\r\n") == string::npos)
+	{
+		out << s;
+		return;
+	}
+
+	out << '"';
+	for (auto c : s)
+	{
+		if (c == '"')
+			out << '"';
+		out << c;
+	}
+	out << '"';
+}
+
+
+// ====================================================
+// ================= VisualizationSink ================
+// ====================================================
+VisualizationSink::VisualizationSink(const string &_window_name, const string &_save_dir, size_t queue_capacity) : window_name(_window_name), save_dir(_save_dir),
+																													queue(queue_capacity), dropped(0)
+{
+	renderer = thread(&VisualizationSink::render, this);
+}
+
+
+VisualizationSink::~VisualizationSink()
+{
+	queue.close();
+	if (renderer.joinable())
+		renderer.join();
+}
+
+
+void VisualizationSink::write(const ResultRecord &record)
+{
+	if (record.image.empty() || !queue.try_push(record))
+		++dropped;
+}
+
+
+unsigned long long VisualizationSink::get_dropped()
+{
+	return dropped;
+}
+
+
+// the same drawing as the result window of show_result
+void VisualizationSink::render()
+{
+	ResultRecord record;
+	while (queue.pop(record))
+	{
+		Mat result_img = record.image.clone();
+		for (auto &it : record.text)
+		{
+			rectangle(result_img, it.box, Scalar(0, 255, 255), 2);
+
+			Size text_size = getTextSize(it.word, FONT_HERSHEY_COMPLEX_SMALL, 1, 1, 0);
+			rectangle(result_img, Rect(it.box.tl().x, it.box.tl().y - 20, text_size.width, text_size.height + 5), Scalar(30, 30, 200, 0), CV_FILLED);
+			putText(result_img, it.word, Point(it.box.tl().x, it.box.tl().y - 4), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(0xff, 0xff, 0xff), 1);
+		}
+
+		if (save_dir.empty())
+		{
+			cv::imshow(window_name, result_img);
+			waitKey(1);
+		}
+		else
+		{
+			char buf[32];
+			sprintf(buf, "%llu.jpg", record.index);
+			cv::imwrite(save_dir + "/" + buf, result_img);
+		}
+	}
+}
@@ -2,16 +2,118 @@
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <string.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "../inc/SpellingCorrector.h"
 
 using namespace std;
 
-bool sortBySecond(const pair<std::string, int>& left, const pair<std::string, int>& right)
+static const unsigned long long fnv_offset = 14695981039346656037ULL;
+static const unsigned long long fnv_prime = 1099511628211ULL;
+static const char dict_magic[4] = { 'S', 'C', 'D', '1' };
+
+// compiled dictionary: this header, then word_offset, counts, pool, keys, posting_offset, postings, slots,
+// every array starts at a multiple of 8 bytes
+struct DictHeader
+{
+  char magic[4];
+  int max_distance;
+  int prefix_length;
+  unsigned word_num;
+  unsigned pool_size;
+  unsigned key_num;
+  unsigned posting_num;
+  unsigned slot_num;
+};
+
+static size_t align8(size_t n)
 {
-  return left.second < right.second;
+  return (n + 7) & ~(size_t)7;
 }
 
+struct SpellingCorrector::Storage
+{
+  Storage() : map_data(nullptr), map_size(0)
+  {
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+  }
+
+  ~Storage()
+  {
+#ifdef _WIN32
+    if (map_data != nullptr) UnmapViewOfFile(map_data);
+    if (mapping != NULL) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+    if (map_data != nullptr) munmap((void*)map_data, map_size);
+#endif
+  }
+
+  bool map(const std::string& filename)
+  {
+#ifdef _WIN32
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+      return false;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+      return false;
+    map_data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    map_size = (size_t)size.QuadPart;
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close(fd);
+      return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+      return false;
+    map_data = (const char*)data;
+    map_size = st.st_size;
+#endif
+    return map_data != nullptr;
+  }
+
+  // index built in memory
+  string pool;
+  vector<unsigned> word_offset;
+  vector<int> counts;
+  vector<unsigned long long> keys;
+  vector<unsigned> posting_offset;
+  vector<unsigned> postings;
+  vector<unsigned> slots;
+
+  // compiled dictionary
+  const char *map_data;
+  size_t map_size;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+};
+
 char filterNonAlphabetic(char& letter)
 {
   if (letter < 0)
@@ -21,9 +123,25 @@ char filterNonAlphabetic(char& letter)
   return '-';
 }
 
-void SpellingCorrector::load(const std::string& filename)
+SpellingCorrector::SpellingCorrector(int _max_distance, int _prefix_length) : max_distance(_max_distance), index_distance(_max_distance), prefix_length(_prefix_length),
+  word_num(0), word_offset(nullptr), pool(nullptr), counts(nullptr), key_num(0), keys(nullptr), posting_offset(nullptr), postings(nullptr), slot_num(0), slots(nullptr)
+{
+}
+
+bool SpellingCorrector::load(const std::string& filename)
 {
   ifstream file(filename.c_str(), ios_base::binary | ios_base::in);
+  if (!file.is_open())
+    return false;
+
+  char magic[4] = { 0 };
+  file.read(magic, 4);
+  if (file && memcmp(magic, dict_magic, 4) == 0)
+  {
+    file.close();
+    return load_compiled(filename);
+  }
+  file.clear();
 
   file.seekg(0, ios_base::end);
   std::streampos length = file.tellg();
@@ -46,52 +164,307 @@ void SpellingCorrector::load(const std::string& filename)
 
     i = end;
   }
+
+  build_index();
+  return true;
+}
+
+bool SpellingCorrector::load_compiled(const std::string& filename)
+{
+  shared_ptr<Storage> mapped = make_shared<Storage>();
+  if (!mapped->map(filename) || mapped->map_size < sizeof(DictHeader))
+    return false;
+
+  DictHeader header;
+  memcpy(&header, mapped->map_data, sizeof(DictHeader));
+
+  // locate every array and check that they are inside the file
+  size_t pos = align8(sizeof(DictHeader));
+  const size_t word_offset_pos = pos;  pos = align8(pos + sizeof(unsigned) * ((size_t)header.word_num + 1));
+  const size_t counts_pos = pos;       pos = align8(pos + sizeof(int) * (size_t)header.word_num);
+  const size_t pool_pos = pos;         pos = align8(pos + header.pool_size);
+  const size_t keys_pos = pos;         pos = align8(pos + sizeof(unsigned long long) * (size_t)header.key_num);
+  const size_t posting_offset_pos = pos; pos = align8(pos + sizeof(unsigned) * ((size_t)header.key_num + 1));
+  const size_t postings_pos = pos;     pos = align8(pos + sizeof(unsigned) * (size_t)header.posting_num);
+  const size_t slots_pos = pos;        pos = pos + sizeof(unsigned) * (size_t)header.slot_num;
+  if (pos > mapped->map_size || header.slot_num == 0 || (header.slot_num & (header.slot_num - 1)) != 0)
+    return false;
+
+  // the offsets and indices are used without checks later, a truncated or corrupt file must fail here
+  const char *data = mapped->map_data;
+  const unsigned *file_word_offset = (const unsigned*)(data + word_offset_pos);
+  const unsigned *file_posting_offset = (const unsigned*)(data + posting_offset_pos);
+  const unsigned *file_postings = (const unsigned*)(data + postings_pos);
+  const unsigned *file_slots = (const unsigned*)(data + slots_pos);
+  if (header.max_distance < 0 || header.prefix_length <= 0 || file_word_offset[0] != 0 || file_posting_offset[0] != 0)
+    return false;
+  for (size_t i = 0; i < header.word_num; i++)
+  {
+    if (file_word_offset[i + 1] < file_word_offset[i] || file_word_offset[i + 1] > header.pool_size)
+      return false;
+  }
+  for (size_t i = 0; i < header.key_num; i++)
+  {
+    if (file_posting_offset[i + 1] < file_posting_offset[i] || file_posting_offset[i + 1] > header.posting_num)
+      return false;
+  }
+  for (size_t i = 0; i < header.posting_num; i++)
+  {
+    if (file_postings[i] >= header.word_num)
+      return false;
+  }
+  // slot values are key + 1, the probing of find_key stops at the first empty slot
+  size_t empty_slot = 0;
+  for (size_t i = 0; i < header.slot_num; i++)
+  {
+    if (file_slots[i] > header.key_num)
+      return false;
+    empty_slot += (file_slots[i] == 0);
+  }
+  if (empty_slot == 0)
+    return false;
+
+  // a text corpus loaded before is replaced
+  dictionary.clear();
+  storage = mapped;
+  max_distance = header.max_distance;
+  index_distance = header.max_distance;
+  prefix_length = header.prefix_length;
+
+  const char *base = mapped->map_data;
+  word_num = header.word_num;
+  word_offset = (const unsigned*)(base + word_offset_pos);
+  counts = (const int*)(base + counts_pos);
+  pool = base + pool_pos;
+  key_num = header.key_num;
+  keys = (const unsigned long long*)(base + keys_pos);
+  posting_offset = (const unsigned*)(base + posting_offset_pos);
+  postings = (const unsigned*)(base + postings_pos);
+  slot_num = header.slot_num;
+  slots = (const unsigned*)(base + slots_pos);
+
+  return true;
+}
+
+bool SpellingCorrector::compile(const std::string& filename)
+{
+  ofstream file(filename.c_str(), ios_base::binary | ios_base::out);
+  if (!file.is_open())
+    return false;
+
+  DictHeader header;
+  memcpy(header.magic, dict_magic, 4);
+  header.max_distance = index_distance;
+  header.prefix_length = prefix_length;
+  header.word_num = word_num;
+  header.pool_size = (word_num > 0) ? word_offset[word_num] : 0;
+  header.key_num = key_num;
+  header.posting_num = (key_num > 0) ? posting_offset[key_num] : 0;
+  header.slot_num = slot_num;
+
+  size_t pos = 0;
+  const char zero[8] = { 0 };
+  auto write_array = [&](const void *data, size_t bytes)
+  {
+    file.write(zero, align8(pos) - pos);
+    pos = align8(pos);
+    file.write((const char*)data, bytes);
+    pos += bytes;
+  };
+
+  write_array(&header, sizeof(DictHeader));
+  const unsigned empty_offset = 0;
+  write_array(word_num > 0 ? word_offset : &empty_offset, sizeof(unsigned) * ((size_t)word_num + 1));
+  write_array(counts, sizeof(int) * (size_t)word_num);
+  write_array(pool, header.pool_size);
+  write_array(keys, sizeof(unsigned long long) * (size_t)key_num);
+  write_array(key_num > 0 ? posting_offset : &empty_offset, sizeof(unsigned) * ((size_t)key_num + 1));
+  write_array(postings, sizeof(unsigned) * (size_t)header.posting_num);
+  write_array(slots, sizeof(unsigned) * (size_t)slot_num);
+
+  return !file.fail();
+}
+
+// a compiled dictionary can not be rebuilt, it only accepts distances up to the one it was compiled with
+void SpellingCorrector::set_max_distance(int d)
+{
+  if (dictionary.empty() && storage && storage->map_data != nullptr)
+  {
+    max_distance = min(d, index_distance);
+    return;
+  }
+
+  max_distance = d;
+  index_distance = d;
+  build_index();
 }
 
+unsigned SpellingCorrector::size()
+{
+  return word_num;
+}
+
+// the closest word within max_distance edits (insertion, deletion, substitution),
+// ties are broken by the word count and then alphabetically, "" if there is none
 string SpellingCorrector::correct(const std::string& word)
 {
-  Vector edited_str;
-  Dictionary candidates;
+  vector<unsigned long long> hashes;
+  deletes(word.c_str(), word.size(), hashes);
+
+  vector<unsigned> candidates;
+  for (unsigned int i = 0; i < hashes.size(); i++)
+  {
+    const int key = find_key(hashes[i]);
+    if (key >= 0)
+      candidates.insert(candidates.end(), postings + posting_offset[key], postings + posting_offset[key + 1]);
+  }
+  sort(candidates.begin(), candidates.end());
+  candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+  // candidates are sorted, so the first word of equal distance and count is the alphabetically smallest
+  int best = -1;
+  int best_distance = max_distance;
+  for (unsigned int i = 0; i < candidates.size(); i++)
+  {
+    const unsigned id = candidates[i];
+    const int d = bounded_distance(word.c_str(), word.size(), pool + word_offset[id], word_offset[id + 1] - word_offset[id], best_distance);
+    if (d > best_distance)
+      continue;
+
+    if (best == -1 || d < best_distance || counts[id] > counts[best])
+    {
+      best = id;
+      best_distance = d;
+    }
+  }
+
+  return (best == -1) ? "" : string(pool + word_offset[best], word_offset[best + 1] - word_offset[best]);
+}
+
+void SpellingCorrector::build_index()
+{
+  shared_ptr<Storage> built = make_shared<Storage>();
 
-  // edit distance 0
-  if (dictionary.find(word) != dictionary.end()) { return word; }
+  built->word_offset.push_back(0);
+  for (Dictionary::iterator it = dictionary.begin(); it != dictionary.end(); ++it)
+  {
+    built->pool += it->first;
+    built->word_offset.push_back(built->pool.size());
+    built->counts.push_back(it->second);
+  }
 
-  // edit distance 1
-  edits(word, edited_str);
-  known(edited_str, candidates);
-  if (candidates.size() > 0) { return max_element(candidates.begin(), candidates.end(), sortBySecond)->first; }
+  // (delete hash, word) of every word, grouped by hash
+  vector<pair<unsigned long long, unsigned> > pairs;
+  vector<unsigned long long> hashes;
+  for (unsigned int i = 0; i < built->counts.size(); i++)
+  {
+    deletes(built->pool.c_str() + built->word_offset[i], built->word_offset[i + 1] - built->word_offset[i], hashes);
+    for (unsigned int j = 0; j < hashes.size(); j++)
+      pairs.push_back(make_pair(hashes[j], i));
+  }
+  sort(pairs.begin(), pairs.end());
 
-  // edit distance 2
-  /*for (unsigned int i = 0;i < edited_str.size();i++)
+  built->postings.resize(pairs.size());
+  for (unsigned int i = 0; i < pairs.size(); i++)
   {
-    Vector subResult;
+    if (i == 0 || pairs[i].first != pairs[i - 1].first)
+    {
+      built->keys.push_back(pairs[i].first);
+      built->posting_offset.push_back(i);
+    }
+    built->postings[i] = pairs[i].second;
+  }
+  built->posting_offset.push_back(pairs.size());
 
-    edits(edited_str[i], subResult);
-    known(subResult, candidates);
-  }*/
-  if (candidates.size() > 0) { return max_element(candidates.begin(), candidates.end(), sortBySecond)->first; }
+  // load factor <= 0.5
+  size_t slot_size = 16;
+  while (slot_size < built->keys.size() * 2)
+    slot_size <<= 1;
+  built->slots.assign(slot_size, 0);
+  for (unsigned int i = 0; i < built->keys.size(); i++)
+  {
+    size_t pos = built->keys[i] & (slot_size - 1);
+    while (built->slots[pos] != 0)
+      pos = (pos + 1) & (slot_size - 1);
+    built->slots[pos] = i + 1;
+  }
 
-  return "";
+  storage = built;
+  word_num = built->counts.size();
+  word_offset = built->word_offset.data();
+  pool = built->pool.c_str();
+  counts = built->counts.data();
+  key_num = built->keys.size();
+  keys = built->keys.data();
+  posting_offset = built->posting_offset.data();
+  postings = built->postings.data();
+  slot_num = built->slots.size();
+  slots = built->slots.data();
 }
 
-void SpellingCorrector::known(Vector& edited_str, Dictionary& candidates)
+// FNV-1a of the word prefix with every combination of up to max_distance characters deleted, sorted and unique
+void SpellingCorrector::deletes(const char *word, int len, std::vector<unsigned long long>& hashes)
 {
-  for (unsigned int i = 0;i < edited_str.size();i++)
+  len = min(len, prefix_length);
+  hashes.clear();
+  for (unsigned mask = 0; mask < (1u << len); mask++)
   {
-    Dictionary::iterator value = dictionary.find(edited_str[i]);
+    int deleted = 0;
+    for (unsigned m = mask; m; m &= m - 1)
+      deleted++;
+    if (deleted > max_distance)
+      continue;
+
+    unsigned long long hash = fnv_offset;
+    for (int i = 0; i < len; i++)
+    {
+      if (!((mask >> i) & 1))
+        hash = (hash ^ (unsigned char)word[i]) * fnv_prime;
+    }
+    hashes.push_back(hash);
+  }
+  sort(hashes.begin(), hashes.end());
+  hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+int SpellingCorrector::find_key(unsigned long long hash)
+{
+  if (slot_num == 0)
+    return -1;
 
-    if (value != dictionary.end()) candidates[value->first] = value->second;
+  const size_t mask = slot_num - 1;
+  for (size_t pos = hash & mask; slots[pos] != 0; pos = (pos + 1) & mask)
+  {
+    if (keys[slots[pos] - 1] == hash)
+      return slots[pos] - 1;
   }
+  return -1;
 }
 
-void SpellingCorrector::edits(const std::string& word, Vector& edited_str)
+// Levenshtein distance of a and b, or max_d + 1 as soon as it is known to exceed max_d
+int SpellingCorrector::bounded_distance(const char *a, int n, const char *b, int m, int max_d)
 {
-  //for (string::size_type i = 0;i < word.size(); i++)    edited_str.push_back(word.substr(0, i) + word.substr(i + 1)); //deletions
-  //for (string::size_type i = 0;i < word.size() - 1;i++) result.push_back(word.substr(0, i) + word[i + 1] + word[i] + word.substr(i + 2)); //transposition
+  if (abs(n - m) > max_d)
+    return max_d + 1;
+
+  vector<int> prev(m + 1);
+  vector<int> cur(m + 1);
+  for (int j = 0; j <= m; j++)
+    prev[j] = j;
 
-  for (char j = 'a'; j <= 'z';++j)
+  for (int i = 1; i <= n; i++)
   {
-    for (string::size_type i = 0;i < word.size(); i++)    edited_str.push_back(word.substr(0, i) + j + word.substr(i + 1)); //alterations
-    for (string::size_type i = 0;i < word.size() + 1;i++) edited_str.push_back(word.substr(0, i) + j + word.substr(i)); //insertion
+    cur[0] = i;
+    int row_min = cur[0];
+    for (int j = 1; j <= m; j++)
+    {
+      cur[j] = min(min(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + (a[i - 1] != b[j - 1]));
+      row_min = min(row_min, cur[j]);
+    }
+    if (row_min > max_d)
+      return max_d + 1;
+    swap(prev, cur);
   }
-}
\ No newline at end of file
+
+  return min(prev[m], max_d + 1);
+}
@@ -0,0 +1,172 @@
+#include "../inc/TextRecognizer.h"
+
+
+// copy of the text that does not point into the ER trees
+void make_text_result(const vector<Text> &text, vector<TextResult> &result)
+{
+	result.resize(text.size());
+	for (int i = 0; i < text.size(); i++)
+	{
+		result[i].word = text[i].word;
+		result[i].box = text[i].box;
+		result[i].slope = text[i].slope;
+		result[i].letter_box.clear();
+		result[i].letter_prob.clear();
+		for (auto it : text[i].ers)
+		{
+			result[i].letter_box.push_back(it->bound);
+			result[i].letter_prob.push_back(it->prob);
+		}
+	}
+}
+
+
+TextRecognizer::TextRecognizer(int thresh_step, int min_area, int max_area, int stability_t, double overlap_coef, double min_ocr_prob)
+{
+	model = make_shared<Model>();
+	model->er_filter = ERFilter(thresh_step, min_area, max_area, stability_t, overlap_coef, min_ocr_prob);
+	model->er_filter.stc = nullptr;
+	model->er_filter.wtc = nullptr;
+	model->er_filter.ocr = nullptr;
+}
+
+
+bool TextRecognizer::load_detector(const string &strong_file, const string &weak_file)
+{
+	shared_ptr<CascadeBoost> stc = make_shared<CascadeBoost>();
+	shared_ptr<CascadeBoost> wtc = make_shared<CascadeBoost>();
+	if (!stc->load_classifier(strong_file) || !wtc->load_classifier(weak_file))
+		return false;
+
+	model->stc = stc;
+	model->wtc = wtc;
+	model->er_filter.stc = stc.get();
+	model->er_filter.wtc = wtc.get();
+	return true;
+}
+
+
+bool TextRecognizer::load_ocr(const string &model_file, const string &tp_file, int img_L, int feature_L)
+{
+	fstream fin(model_file, fstream::in);
+	if (!fin.is_open())
+	{
+		std::cout << "Error: the OCR model file is not opened!!" << endl;
+		return false;
+	}
+	fin.close();
+
+	model->ocr = make_shared<OCR>(model_file.c_str(), img_L, feature_L);
+	model->er_filter.ocr = model->ocr.get();
+	return model->er_filter.load_tp_table(tp_file.c_str());
+}
+
+
+bool TextRecognizer::load_dictionary(const string &filename)
+{
+	shared_ptr<SpellingCorrector> corrector = make_shared<SpellingCorrector>();
+	if (!corrector->load(filename))
+		return false;
+
+	model->corrector = corrector;
+	model->er_filter.corrector = corrector.get();
+	return true;
+}
+
+
+bool TextRecognizer::load_lexicon(const string &filename)
+{
+	shared_ptr<Lexicon> lexicon = make_shared<Lexicon>();
+	if (!lexicon->load(filename))
+		return false;
+
+	model->lexicon = lexicon;
+	model->er_filter.lexicon = lexicon.get();
+	return true;
+}
+
+
+void TextRecognizer::set_ocr_top_k(int k)
+{
+	model->er_filter.set_ocr_top_k(k);
+}
+
+
+void TextRecognizer::set_beam_width(int b)
+{
+	model->er_filter.set_beam_width(b);
+}
+
+
+void TextRecognizer::set_thread_num(int n)
+{
+	model->er_filter.set_thread_num(n);
+}
+
+
+void TextRecognizer::set_pipeline(int features)
+{
+	model->er_filter.set_pipeline(features);
+}
+
+
+// the cache is locked per shard, so it is the one part of the model that calls share on purpose
+void TextRecognizer::enable_ocr_cache(size_t capacity)
+{
+	if (model->ocr)
+		model->ocr->enable_cache(capacity);
+}
+
+
+bool TextRecognizer::is_ready()
+{
+	return model->stc && model->wtc && model->ocr;
+}
+
+
+vector<TextResult> TextRecognizer::recognize(const Mat &image) const
+{
+	Context context;
+	return recognize(image, context);
+}
+
+
+// The model is only read: the cascades, the OCR classifier and the corrector have no per-call state,
+// and everything text_detect writes (ER trees, decode times) lives in the context.
+vector<TextResult> TextRecognizer::recognize(const Mat &image, Context &context) const
+{
+	vector<TextResult> results;
+	if (image.empty())
+		return results;
+
+	Mat src;
+	if (image.channels() == 1)
+		cvtColor(image, src, COLOR_GRAY2BGR);
+	else
+		src = image;
+
+	context.er_filter = model->er_filter;
+	context.root.clear();
+	context.all.clear();
+	context.pool.clear();
+	context.strong.clear();
+	context.weak.clear();
+	context.tracked.clear();
+	context.text.clear();
+	context.times = context.er_filter.text_detect(src, context.root, context.all, context.pool, context.strong, context.weak, context.tracked, context.text);
+
+	make_text_result(context.text, results);
+
+	// every ER of the call hangs on one of the roots
+	for (auto it : context.root)
+		context.er_filter.er_delete(it);
+	context.root.clear();
+	context.all.clear();
+	context.pool.clear();
+	context.strong.clear();
+	context.weak.clear();
+	context.tracked.clear();
+	context.text.clear();
+
+	return results;
+}
@@ -0,0 +1,192 @@
+#include "../inc/TextTrackManager.h"
+
+
+TextTrackManager::TextTrackManager(double min_iou, double min_similarity, double min_confidence, double box_change_iou, int max_missed, int refresh_interval) : MIN_IOU(min_iou), MIN_SIMILARITY(min_similarity),
+																																								MIN_CONFIDENCE(min_confidence), BOX_CHANGE_IOU(box_change_iou), MAX_MISSED(max_missed),
+																																								REFRESH_INTERVAL(refresh_interval), next_id(0), ocr_count(0), skip_count(0)
+{
+}
+
+
+void TextTrackManager::update(ERFilter *er_filter, ERs &all_er, vector<Mat> &channel, vector<Text> &text)
+{
+	Mat &gray = channel[0];		// Y of YCrCb
+	const int n = text.size();
+	vector<Mat> appearance(n);
+	for (int i = 0; i < n; i++)
+		make_appearance(gray, text[i].box, appearance[i]);
+
+	// greedy association, the pair with the highest IoU + similarity first
+	struct Pair
+	{
+		double score;
+		int text;
+		int track;
+	};
+	vector<Pair> pairs;
+	for (int i = 0; i < n; i++)
+	{
+		for (int t = 0; t < tracks.size(); t++)
+		{
+			const double o = iou(text[i].box, tracks[t].text.box);
+			if (o < MIN_IOU)
+				continue;
+			const double s = similarity(appearance[i], tracks[t].appearance);
+			if (s < MIN_SIMILARITY)
+				continue;
+			pairs.push_back({ o + s, i, t });
+		}
+	}
+	sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b) { return a.score > b.score; });
+
+	vector<int> match(n, -1);
+	vector<bool> used(tracks.size(), false);
+	for (auto &it : pairs)
+	{
+		if (match[it.text] == -1 && !used[it.track])
+		{
+			match[it.text] = it.track;
+			used[it.track] = true;
+		}
+	}
+
+	for (auto &it : tracks)
+	{
+		++it.missed;
+		++it.since_ocr;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		int t = match[i];
+		Rect box = text[i].box;
+		const bool need_ocr = t == -1 || tracks[t].confidence < MIN_CONFIDENCE ||
+							iou(box, tracks[t].ocr_box) < BOX_CHANGE_IOU || tracks[t].since_ocr >= REFRESH_INTERVAL;
+		if (need_ocr)
+		{
+			vector<Text> single(1, text[i]);
+			er_filter->er_ocr(all_er, channel, single);
+			++ocr_count;
+
+			// rejected by the OCR, a known track is still seen but gets no vote
+			if (!single.empty())
+			{
+				if (t == -1)
+				{
+					TextTrack track;
+					track.id = next_id++;
+					track.confidence = 0;
+					track.ocr_count = 0;
+					tracks.push_back(track);
+					t = tracks.size() - 1;
+				}
+				box = single.front().box;
+				vote(tracks[t], single.front());
+			}
+			else if (t == -1)
+				continue;
+		}
+		else
+			++skip_count;
+
+		TextTrack &track = tracks[t];
+		track.text.box = box;
+		track.text.slope = text[i].slope;
+		track.missed = 0;
+		track.appearance = appearance[i];
+	}
+
+	tracks.erase(remove_if(tracks.begin(), tracks.end(), [this](const TextTrack &it) { return it.missed > MAX_MISSED; }), tracks.end());
+
+	text.clear();
+	for (auto &it : tracks)
+	{
+		if (it.missed == 0)
+			text.push_back(it.text);
+	}
+}
+
+
+const vector<TextTrack>& TextTrackManager::get_tracks()
+{
+	return tracks;
+}
+
+
+unsigned long long TextTrackManager::get_ocr_count()
+{
+	return ocr_count;
+}
+
+
+unsigned long long TextTrackManager::get_skip_count()
+{
+	return skip_count;
+}
+
+
+double TextTrackManager::iou(const Rect &a, const Rect &b)
+{
+	const double inter = (a & b).area();
+	const double uni = a.area() + b.area() - inter;
+	return (uni > 0) ? inter / uni : 0;
+}
+
+
+void TextTrackManager::make_appearance(Mat &gray, const Rect &box, Mat &appearance)
+{
+	const Rect r = box & Rect(0, 0, gray.cols, gray.rows);
+	if (r.area() == 0)
+		appearance = Mat::zeros(16, 32, CV_8U);
+	else
+		resize(gray(r), appearance, Size(32, 16), 0, 0, INTER_AREA);
+}
+
+
+double TextTrackManager::similarity(Mat &a, Mat &b)
+{
+	if (a.empty() || b.empty())
+		return 0;
+
+	Mat diff;
+	absdiff(a, b, diff);
+	return 1 - mean(diff)[0] / 255;
+}
+
+
+// older readings fade, the weight of a reading is the mean letter probability of its ERs
+void TextTrackManager::vote(TextTrack &track, Text &text)
+{
+	const double decay = 0.8;
+	for (auto it = track.votes.begin(); it != track.votes.end();)
+	{
+		it->second *= decay;
+		if (it->second < 0.01)
+			it = track.votes.erase(it);
+		else
+			++it;
+	}
+
+	double prob = 0;
+	for (auto it : text.ers)
+		prob += it->prob;
+	prob = text.ers.empty() ? 0.5 : prob / text.ers.size();
+	track.votes[text.word] += prob;
+
+	double best = 0;
+	double sum = 0;
+	for (auto &it : track.votes)
+	{
+		sum += it.second;
+		if (it.second > best)
+		{
+			best = it.second;
+			track.text.word = it.first;
+		}
+	}
+
+	track.confidence = best / (sum + 1);
+	track.ocr_box = text.box;
+	track.since_ocr = 0;
+	++track.ocr_count;
+}
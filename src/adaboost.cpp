@@ -249,31 +249,25 @@ void AdaBoost::real_training(TrainingData &td)
 	const int dims = td.get_dim();
 	const int nums = td.get_num();
 
-	double Pr_p = .0;
-	double Pr_n = .0;
-	double Pw_p = .0;
-	double Pw_n = .0;
-	double current_Z = .0;
-	double min_Z = DBL_MAX;
+	double min_Z;
 	double c_p;
 	double c_n;
-	double epsilon = 1.0 / (4.0 * nums);
 	double thresh;
 	int dim;
-	int dir = 1;
 
 
-	// make threshold set (element of set is unique)
-	vector<set<double> > thresh_set(dims);
+	// sort every column once, the stump search sweeps them in order
+	vector<vector<ColFea>> sorted_data(dims, vector<ColFea>(nums));
 #pragma omp parallel for
 	for (int i = 0; i < dims; i++)
 	{
-		vector<double> column_data(nums);
 		for (int j = 0; j < nums; j++)
 		{
-			column_data[j] = td.data[j].fv[i];
+			sorted_data[i][j].f = td.data[j].fv[i];
+			sorted_data[i][j].idx = j;
+			sorted_data[i][j].label = td.data[j].label;
 		}
-		thresh_set[i] = set<double>(column_data.begin(), column_data.end());
+		sort(sorted_data[i].begin(), sorted_data[i].end(), [](ColFea a, ColFea b) { return a.f < b.f; });
 	}
 	
 
@@ -302,42 +296,8 @@ void AdaBoost::real_training(TrainingData &td)
 
 	for (int t = 0; t < num_of_iter; t++)
 	{
-		min_Z = DBL_MAX;
-
 		// search all the weak classifiers
-		for (int i = 0; i < dims; i++)
-		{
-			for (set<double>::iterator it = thresh_set[i].begin(); it != thresh_set[i].end(); it++)
-			{
-				Pr_p = .0;
-				Pr_n = .0;
-				Pw_p = .0;
-				Pw_n = .0;
-
-				for (int j = 0; j < nums; j++)
-				{
-					if (td.data[j].fv[i] < *it && td.data[j].label == POS)
-						Pr_p += weight[j];
-					else if (td.data[j].fv[i] < *it && td.data[j].label == NEG)
-						Pw_n += weight[j];
-					else if (td.data[j].fv[i] >= *it && td.data[j].label == POS)
-						Pw_p += weight[j];
-					else if (td.data[j].fv[i] >= *it && td.data[j].label == NEG)
-						Pr_n += weight[j];
-				}
-
-				current_Z = 2 * (sqrt(Pr_p*Pw_n) + sqrt(Pr_n*Pw_p));
-				if (current_Z < min_Z)
-				{
-					min_Z = current_Z;
-					dim = i;
-					thresh = *it;
-
-					c_p = 0.5 * log((Pr_p + epsilon) / (Pw_n + epsilon));
-					c_n = 0.5 * log((Pw_p + epsilon) / (Pr_n + epsilon));
-				}
-			}
-		}
+		min_Z = search_stump(REAL, sorted_data, weight, dim, thresh, c_p, c_n);
 
 		strong_classifier.push_back(new RealDecisionStump(dim, thresh, c_p, c_n));
 		classifier_weight.push_back(1.0);
@@ -385,6 +345,203 @@ void AdaBoost::real_training(TrainingData &td)
 	}
 }
 
+// The loss of a stump that sends the samples with f < thresh to the left side
+//  REAL:	Z = 2 * (sqrt(Pr_p*Pw_n) + sqrt(Pr_n*Pw_p))
+//  GENTLE:	weighted squared error of the regression stump, 4*P*N/(P+N) on each side
+double AdaBoost::stump_loss(int boost, double Pr_p, double Pw_n, double Pw_p, double Pr_n)
+{
+	if (boost == GENTLE)
+	{
+		const double left = Pr_p + Pw_n;
+		const double right = Pw_p + Pr_n;
+		return ((left > 0) ? 4 * Pr_p*Pw_n / left : 0) + ((right > 0) ? 4 * Pw_p*Pr_n / right : 0);
+	}
+	return 2 * (sqrt(Pr_p*Pw_n) + sqrt(Pr_n*Pw_p));
+}
+
+
+// the dim with the lowest loss, ties go to the lowest dim so the result does not depend on the thread
+// schedule. c_p and c_n are the outputs of the left and right side, returns the loss
+double AdaBoost::select_stump(int boost, const vector<StumpSplit> &split, double total_pos_weight, double total_neg_weight, double epsilon, int &dim, double &thresh, double &c_p, double &c_n)
+{
+	double min_loss = DBL_MAX;
+	dim = 0;
+	for (int i = 0; i < split.size(); i++)
+	{
+		if (split[i].loss < min_loss)
+		{
+			min_loss = split[i].loss;
+			dim = i;
+		}
+	}
+
+	const double Pr_p = split[dim].Pr_p;
+	const double Pw_n = split[dim].Pw_n;
+	const double Pw_p = max(.0, total_pos_weight - Pr_p);
+	const double Pr_n = max(.0, total_neg_weight - Pw_n);
+	thresh = split[dim].thresh;
+	if (boost == GENTLE)
+	{
+		c_p = (Pr_p + Pw_n > 0) ? (Pr_p - Pw_n) / (Pr_p + Pw_n) : 0;
+		c_n = (Pw_p + Pr_n > 0) ? (Pw_p - Pr_n) / (Pw_p + Pr_n) : 0;
+	}
+	else
+	{
+		c_p = 0.5 * log((Pr_p + epsilon) / (Pw_n + epsilon));
+		c_n = 0.5 * log((Pw_p + epsilon) / (Pr_n + epsilon));
+	}
+	return min_loss;
+}
+
+
+// Stump with the lowest loss over the unique values of every column as thresholds. Every column is
+// sorted, so one sweep with running sums evaluates all of its thresholds: O(dims * nums) instead of
+// O(dims * unique values * nums). The columns are searched in parallel.
+double AdaBoost::search_stump(int boost, const vector<vector<ColFea>> &sorted_data, const vector<double> &weight, int &dim, double &thresh, double &c_p, double &c_n)
+{
+	const int dims = sorted_data.size();
+	const int nums = sorted_data.front().size();
+	const double epsilon = 1.0 / (4.0 * nums);
+
+	// get total weight for both pos and neg
+	double total_pos_weight = .0;
+	double total_neg_weight = .0;
+	for (auto &it : sorted_data.front())
+	{
+		if (it.label == POS)
+			total_pos_weight += weight[it.idx];
+		else
+			total_neg_weight += weight[it.idx];
+	}
+
+	vector<StumpSplit> split(dims, StumpSplit{ DBL_MAX, 0, 0, 0 });
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < dims; i++)
+	{
+		const vector<ColFea> &column = sorted_data[i];
+		double Pr_p = .0;		// POS on the left
+		double Pw_n = .0;		// NEG on the left
+		for (int j = 0; j < nums; j++)
+		{
+			// the samples before j are exactly those with f < column[j].f
+			if (j == 0 || column[j].f != column[j - 1].f)
+			{
+				const double loss = stump_loss(boost, Pr_p, Pw_n, max(.0, total_pos_weight - Pr_p), max(.0, total_neg_weight - Pw_n));
+				if (loss < split[i].loss)
+					split[i] = StumpSplit{ loss, column[j].f, Pr_p, Pw_n };
+			}
+
+			if (column[j].label == POS)
+				Pr_p += weight[column[j].idx];
+			else
+				Pw_n += weight[column[j].idx];
+		}
+	}
+
+	return select_stump(boost, split, total_pos_weight, total_neg_weight, epsilon, dim, thresh, c_p, c_n);
+}
+
+
+// Bucket the features once per layer. A dim with at most max_bin unique values gets one bin per value,
+// and the histogram search is then exact: the integer LBP counts of make_LBP_hist have at most 145.
+// Otherwise the lower bounds are the quantiles of the sorted column.
+void AdaBoost::make_binned_data(const vector<vector<ColFea>> &sorted_data, int max_bin, BinnedData &binned)
+{
+	const int dims = sorted_data.size();
+	const int nums = sorted_data.front().size();
+	max_bin = min(max(max_bin, 1), 256);
+
+	binned.value.assign(dims, vector<double>());
+	binned.bin.assign(dims, vector<uint8_t>(nums));
+	binned.label.resize(nums);
+	for (auto &it : sorted_data.front())
+		binned.label[it.idx] = it.label;
+
+#pragma omp parallel for
+	for (int i = 0; i < dims; i++)
+	{
+		const vector<ColFea> &column = sorted_data[i];
+		vector<double> &value = binned.value[i];
+		for (int j = 0; j < nums; j++)
+		{
+			if (j == 0 || column[j].f != column[j - 1].f)
+				value.push_back(column[j].f);
+		}
+
+		if (value.size() > max_bin)
+		{
+			value.clear();
+			for (int b = 0; b < max_bin; b++)
+			{
+				const double f = column[(long long)b * nums / max_bin].f;
+				if (value.empty() || f != value.back())
+					value.push_back(f);
+			}
+		}
+
+		int b = 0;
+		for (int j = 0; j < nums; j++)
+		{
+			while (b + 1 < value.size() && column[j].f >= value[b + 1])
+				b++;
+			binned.bin[i][column[j].idx] = b;
+		}
+	}
+}
+
+
+// Stump with the lowest loss over the bin lower bounds as thresholds, in the style of the histogram
+// trainers of LightGBM and XGBoost: every dim builds the POS and NEG weight of its bins in one pass
+// over its uint8 column, then sweeps at most 256 bins. The dims are built and searched in parallel.
+double AdaBoost::search_hist_stump(int boost, const BinnedData &binned, const vector<double> &weight, int &dim, double &thresh, double &c_p, double &c_n)
+{
+	const int dims = binned.bin.size();
+	const int nums = binned.label.size();
+	const double epsilon = 1.0 / (4.0 * nums);
+
+	double total_pos_weight = .0;
+	double total_neg_weight = .0;
+	for (int j = 0; j < nums; j++)
+	{
+		if (binned.label[j] == POS)
+			total_pos_weight += weight[j];
+		else
+			total_neg_weight += weight[j];
+	}
+
+	vector<StumpSplit> split(dims, StumpSplit{ DBL_MAX, 0, 0, 0 });
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < dims; i++)
+	{
+		const vector<double> &value = binned.value[i];
+		const uint8_t *bin = binned.bin[i].data();
+		double hist_p[256] = {};
+		double hist_n[256] = {};
+		for (int j = 0; j < nums; j++)
+		{
+			if (binned.label[j] == POS)
+				hist_p[bin[j]] += weight[j];
+			else
+				hist_n[bin[j]] += weight[j];
+		}
+
+		double Pr_p = .0;		// POS on the left
+		double Pw_n = .0;		// NEG on the left
+		for (int b = 0; b < value.size(); b++)
+		{
+			const double loss = stump_loss(boost, Pr_p, Pw_n, max(.0, total_pos_weight - Pr_p), max(.0, total_neg_weight - Pw_n));
+			if (loss < split[i].loss)
+				split[i] = StumpSplit{ loss, value[b], Pr_p, Pw_n };
+
+			Pr_p += hist_p[b];
+			Pw_n += hist_n[b];
+		}
+	}
+
+	return select_stump(boost, split, total_pos_weight, total_neg_weight, epsilon, dim, thresh, c_p, c_n);
+}
+
+
 bool AdaBoost::load_classifier(string filename)
 {
 	fstream fin;
@@ -488,14 +645,15 @@ void AdaBoost::print_classifier()
 //==================================================
 //=============== Cascade Adaboost =================
 //==================================================
-CascadeBoost::CascadeBoost() { }
-CascadeBoost::CascadeBoost(string filename)
+CascadeBoost::CascadeBoost() : max_bin(0) { }
+CascadeBoost::CascadeBoost(string filename) : max_bin(0)
 {
 	load_classifier(filename);
 }
-CascadeBoost::CascadeBoost(int boost, int base, double _Ftarget, double _f, double _d) : boost_type(boost), base_type(base), Ftarget(_Ftarget), f(_f), d(_d)  {}
+CascadeBoost::CascadeBoost(int boost, int base, double _Ftarget, double _f, double _d) : boost_type(boost), base_type(base), Ftarget(_Ftarget), f(_f), d(_d), max_bin(0)  {}
 
 void CascadeBoost::set_num_iter(int _iter) { ; }
+void CascadeBoost::set_max_bin(int n) { max_bin = n; }
 int CascadeBoost::get_num_iter() { return classifier.size(); }
 
 double CascadeBoost::predict(vector<double> fv)
@@ -517,7 +675,7 @@ double CascadeBoost::predict(vector<double> fv)
 		}
 	}
 
-	else if (boost_type == REAL)
+	else if (boost_type == REAL || boost_type == GENTLE)
 	{
 		for (int i = 0; i < num_of_iter.size(); i++)
 		{
@@ -558,24 +716,30 @@ void CascadeBoost::train_classifier(TrainingData &td, string outfile)
 		const int nums = td.get_num();
 		const int dims = td.get_dim();
 
-		// make threshold set (element of set is unique) and sorted data
-		vector<set<double>> thresh_set(dims);
+		// make sorted data, and the threshold set (element of set is unique) that only discrete_training reads
+		vector<set<double>> thresh_set((boost_type == DISCRETE) ? dims : 0);
 		vector<vector<ColFea>> sorted_data(dims, vector<ColFea>(nums));
 #pragma omp parallel for
 		for (int m = 0; m < dims; m++)
 		{
-			vector<double> column_data(nums);
 			for (int n = 0; n < nums; n++)
 			{
-				column_data[n] = td.data[n].fv[m];
 				sorted_data[m][n].f = td.data[n].fv[m];
 				sorted_data[m][n].idx = n;
 				sorted_data[m][n].label = td.data[n].label;
 			}
-			thresh_set[m] = set<double>(column_data.begin(), column_data.end());
 			sort(sorted_data[m].begin(), sorted_data[m].end(), [](ColFea a, ColFea b) { return a.f < b.f; });
+			if (boost_type == DISCRETE)
+			{
+				for (auto &it : sorted_data[m])
+					thresh_set[m].insert(thresh_set[m].end(), it.f);
+			}
 		}
 
+		BinnedData binned;
+		if (max_bin > 0 && boost_type != DISCRETE)
+			make_binned_data(sorted_data, max_bin, binned);
+
 
 
 		vector<double>weight(nums, 1.0 / nums);
@@ -607,9 +771,9 @@ void CascadeBoost::train_classifier(TrainingData &td, string outfile)
 			if (boost_type == DISCRETE)
 				discrete_training(td, thresh_set, sorted_data, weight);
 			else if (boost_type == REAL)
-				real_training(td, thresh_set, sorted_data, weight);
+				real_training(td, sorted_data, binned, weight);
 			else if (boost_type == GENTLE)
-				gentle_training(td, thresh_set, sorted_data, weight);
+				gentle_training(td, sorted_data, binned, weight);
 
 			// Evaluate current cascaded classifier on validation set to 
 			// determine Fi and Di
@@ -762,87 +926,21 @@ void CascadeBoost::discrete_training(TrainingData &td, vector<set<double>> &thre
 }
 
 
-void CascadeBoost::real_training(TrainingData &td, vector<set<double>> &thresh_set, vector<vector<ColFea>> &sorted_data, vector<double> &weight)
+void CascadeBoost::real_training(TrainingData &td, vector<vector<ColFea>> &sorted_data, BinnedData &binned, vector<double> &weight)
 {
-	const int dims = td.get_dim();
 	const int nums = td.get_num();
-	
-	omp_lock_t update_lock;
-	omp_init_lock(&update_lock);
-
 
-	double total_pos_weight = .0;
-	double total_neg_weight = .0;
-	double min_Z = DBL_MAX;
+	double min_Z;
 	double c_p;
 	double c_n;
-	double epsilon = 1.0 / (4.0 * nums);
 	double thresh;
 	int dim;
 
-	min_Z = DBL_MAX;
-
-	// get total weight for both pos and neg
-	for (int j = 0; j < nums; j++)
-	{
-		if (td.data[j].label == POS)
-			total_pos_weight += weight[j];
-		else
-			total_neg_weight += weight[j];
-	}
-
 	// search all the weak classifiers
-#pragma omp parallel for
-	for (int i = 0; i < dims; i++)
-	{
-		double Pr_p = .0;
-		double Pr_n = .0;
-		double Pw_p = .0;
-		double Pw_n = .0;
-		double current_Z = .0;
-		for (set<double>::iterator it = thresh_set[i].begin(); it != thresh_set[i].end(); it++)
-		{
-			Pr_p = .0;
-			Pr_n = total_neg_weight;
-			Pw_p = total_pos_weight;
-			Pw_n = .0;
-
-			int j = 0;
-			while (j < nums && sorted_data[i][j].f < *it)
-			{
-				int idx = sorted_data[i][j].idx;
-				if (sorted_data[i][j].label == POS)
-				{
-					Pr_p += weight[idx];
-					Pw_p -= weight[idx];
-				}
-				else
-				{
-					Pw_n += weight[idx];
-					Pr_n -= weight[idx];
-				}
-
-				j++;
-			}
-
-			current_Z = 2 * (sqrt(Pr_p*Pw_n) + sqrt(Pr_n*Pw_p));
-			if (current_Z < min_Z)
-			{
-				omp_set_lock(&update_lock);
-				if (current_Z < min_Z)
-				{
-					min_Z = current_Z;
-					dim = i;
-					thresh = *it;
-
-					c_p = 0.5 * log((Pr_p + epsilon) / (Pw_n + epsilon));
-					c_n = 0.5 * log((Pw_p + epsilon) / (Pr_n + epsilon));
-				}
-				omp_unset_lock(&update_lock);
-			}
-			
-		}
-	}
+	if (max_bin > 0)
+		min_Z = search_hist_stump(REAL, binned, weight, dim, thresh, c_p, c_n);
+	else
+		min_Z = search_stump(REAL, sorted_data, weight, dim, thresh, c_p, c_n);
 
 	classifier.push_back(new RealDecisionStump(dim, thresh, c_p, c_n));
 	classifier_weight.push_back(1.0);
@@ -858,9 +956,37 @@ void CascadeBoost::real_training(TrainingData &td, vector<set<double>> &thresh_s
 }
 
 
-void CascadeBoost::gentle_training(TrainingData &td, vector<set<double>> &thresh_set, vector<vector<ColFea>> &sorted_data, vector<double> &weight)
+// Gentle AdaBoost, the stump is a weighted least square regression: the output of each side is
+// (P - N) / (P + N), the weighted mean of the labels. It is stored as a RealDecisionStump.
+void CascadeBoost::gentle_training(TrainingData &td, vector<vector<ColFea>> &sorted_data, BinnedData &binned, vector<double> &weight)
 {
+	const int nums = td.get_num();
 
+	double c_p;
+	double c_n;
+	double thresh;
+	int dim;
+
+	// search all the weak classifiers
+	if (max_bin > 0)
+		search_hist_stump(GENTLE, binned, weight, dim, thresh, c_p, c_n);
+	else
+		search_stump(GENTLE, sorted_data, weight, dim, thresh, c_p, c_n);
+
+	classifier.push_back(new RealDecisionStump(dim, thresh, c_p, c_n));
+	classifier_weight.push_back(1.0);
+
+	// update weight of exmaples
+	double normalize_factor = 0;
+	for (int j = 0; j < nums; j++)
+	{
+		const double fx = (td.data[j].fv[dim] < thresh) ? c_p : c_n;
+		weight[j] = weight[j] * exp(-1 * td.data[j].label*fx);
+		normalize_factor += weight[j];
+	}
+
+	for (int j = 0; j < nums; j++)
+		weight[j] /= normalize_factor;
 }
 
 
@@ -881,7 +1007,7 @@ bool CascadeBoost::load_classifier(string filename)
 	if (buffer == "boost_type")
 	{
 		fin >> buffer;
-		boost_type = (buffer == "DISCRETE") ? DISCRETE : REAL;
+		boost_type = (buffer == "DISCRETE") ? DISCRETE : (buffer == "GENTLE") ? GENTLE : REAL;
 	}
 	fin >> buffer;
 	if (buffer == "base_type")
@@ -953,7 +1079,7 @@ bool CascadeBoost::write_classifier(string filename)
 		return false;
 	}
 
-	string s_boost_type = (boost_type == DISCRETE) ? "DISCRETE" : "REAL";
+	string s_boost_type = (boost_type == DISCRETE) ? "DISCRETE" : (boost_type == GENTLE) ? "GENTLE" : "REAL";
 	string s_base_type = (base_type == DECISION_STUMP) ? "DECISION_STUMP" : "";
 
 	fout << "boost_type " << s_boost_type << endl;
@@ -7,14 +7,26 @@
 #include "../inc/OCR.h"
 #include "../inc/adaboost.h"
 #include "../inc/utils.h"
+#include "../inc/TextRecognizer.h"
+#include "../inc/BoundedQueue.h"
+#include "../inc/LatestFrameBuffer.h"
+#include "../inc/DetectionScheduler.h"
+#include "../inc/ChangeDetector.h"
+#include "../inc/TextTrackManager.h"
+#include "../inc/ResultSink.h"
+#include "../inc/QualityController.h"
 
 
 using namespace std;
 using namespace cv;
 
-int icdar_mode(ERFilter* er_filter);
+int icdar_mode(ERFilter* er_filter, bool show, char csv_file[]);
 int image_mode(ERFilter* er_filter, char filename[]);
 int video_mode(ERFilter* er_filter, char filename[]);
+int batch_mode(char path[], int worker_num, int pipeline);
+int live_mode(ERFilter* er_filter, char filename[]);
+int change_mode(ERFilter* er_filter, char filename[]);
+int golden_mode(ERFilter* er_filter, char mode[], char filename[], int image_num);
 
 int main(int argc, char* argv[])
 {
@@ -33,20 +45,88 @@ int main(int argc, char* argv[])
 	//test_best_detval();
 	//make_video_ground_truth();
 	//calc_video_result();
+	//compare_chain_feature();
+	//compare_ocr_classifier();
+	//report_ocr_compression();
+	//benchmark_lattice_decode();
+	//benchmark_recognizer_scaling();
+	//compare_golden_config();
+	//verify_lexicon();
+	//compile_lexicon();
 	//return 0;
 
 
+	// -noocr anywhere in the arguments runs detection only, -trace records the stages of every frame,
+	// -show and -csv [file] are the display and the CSV output of -icdar
+	int pipeline = PIPELINE_OCR;
+	bool trace = false;
+	bool show = false;
+	char *csv_file = nullptr;
+	for (int i = argc - 1; i >= 1; i--)
+	{
+		int arg_num = 1;
+		if (strcmp(argv[i], "-noocr") == 0)
+			pipeline &= ~PIPELINE_OCR;
+		else if (strcmp(argv[i], "-trace") == 0)
+			trace = true;
+		else if (strcmp(argv[i], "-show") == 0)
+			show = true;
+		else if (strcmp(argv[i], "-csv") == 0 && i + 1 < argc)
+		{
+			csv_file = argv[i + 1];
+			arg_num = 2;
+		}
+		else
+			continue;
+
+		for (int j = i; j + arg_num <= argc; j++)
+			argv[j] = argv[j + arg_num];
+		argc -= arg_num;
+	}
+
+	if (trace)
+	{
+		Profiler::enable(true);
+		Profiler::set_metrics_dump("metrics.txt", 100);
+	}
+
+	// batch mode loads its own models into a TextRecognizer
+	if (argc >= 3 && strcmp(argv[1], "-b") == 0)
+	{
+		int worker_num = (argc >= 4) ? atoi(argv[3]) : thread::hardware_concurrency();
+		const int ret = batch_mode(argv[2], max(1, worker_num), pipeline);
+		if (trace)
+		{
+			Profiler::enable(false);
+			Profiler::write_chrome_trace("trace.json");
+			Profiler::report_latency(cout);
+		}
+		return ret;
+	}
+
 	ERFilter* er_filter = new ERFilter(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
 	er_filter->stc = new CascadeBoost("er_classifier/strong.classifier");
 	er_filter->wtc = new CascadeBoost("er_classifier/weak.classifier");
 	er_filter->ocr = new OCR("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
 	er_filter->load_tp_table("dictionary/tp_table.txt");
-	er_filter->corrector.load("dictionary/big.txt");
+	er_filter->corrector = new SpellingCorrector();
+	if (!er_filter->corrector->load("dictionary/big.dict"))	// compiled by compile_dictionary()
+		er_filter->corrector->load("dictionary/big.txt");
+	er_filter->set_ocr_top_k(OCR_CANDIDATE_NUM);
+	er_filter->set_beam_width(OCR_BEAM_WIDTH);
+	er_filter->lexicon = new Lexicon();
+	if (!er_filter->lexicon->load("dictionary/big.lex"))	// compiled by compile_lexicon(), decode without a lexicon if absent
+	{
+		delete er_filter->lexicon;
+		er_filter->lexicon = nullptr;
+	}
+	er_filter->set_pipeline(pipeline);
 
 	char *filename = nullptr;
+	int ret = 0;
 	if (strcmp(argv[1],"-icdar") == 0)
 	{
-		icdar_mode(er_filter);
+		icdar_mode(er_filter, show, csv_file);
 	}
 	else if(strcmp(argv[1], "-v") == 0)
 	{
@@ -64,29 +144,86 @@ int main(int argc, char* argv[])
 		}
 		image_mode(er_filter, filename);
 	}
+	else if (strcmp(argv[1], "-l") == 0)
+	{
+		if (argc == 3)
+		{
+			filename = argv[2];
+		}
+		live_mode(er_filter, filename);
+	}
+	else if (strcmp(argv[1], "-c") == 0)
+	{
+		if (argc == 3)
+		{
+			filename = argv[2];
+		}
+		change_mode(er_filter, filename);
+	}
+	else if (strcmp(argv[1], "-golden") == 0 && argc >= 4)
+	{
+		ret = golden_mode(er_filter, argv[2], argv[3], (argc >= 5) ? atoi(argv[4]) : 328);
+	}
 	else
 	{
 		cerr << "Wrong input argument! Usage as follow: " << endl;
 		cerr << "[thisfile] -v [infile]: take video as input, default for camera" << endl;
 		cerr << "[thisfile] -i [infile]: take image as input" << endl;
-		cerr << "[thisfile] -icdar: take icdar dataset as input" << endl;
+		cerr << "[thisfile] -l [infile]: live stream, always process the newest frame, default for camera" << endl;
+		cerr << "[thisfile] -c [infile]: static camera, only process the regions that changed, default for camera" << endl;
+		cerr << "[thisfile] -icdar [-show] [-csv file]: take icdar dataset as input, write icdar_result.jsonl, -show to display the result, -csv to also write a csv file" << endl;
+		cerr << "[thisfile] -b [dir or list.txt] [workers]: recognize every image headless, write batch_result.txt" << endl;
+		cerr << "[thisfile] -golden record [file] [image number]: write the output of every stage on the icdar dataset" << endl;
+		cerr << "[thisfile] -golden compare [file] [image number]: compare every stage with a recorded output, write golden_diff.txt" << endl;
+		cerr << "add -noocr to any of them for detection only" << endl;
+		cerr << "add -trace to write trace.json, metrics.txt and the latency of every stage" << endl;
+	}
+
+	if (trace)
+	{
+		Profiler::enable(false);
+		Profiler::write_chrome_trace("trace.json");
+		Profiler::report_latency(cout);
 	}
 
 	delete er_filter->wtc;
 	delete er_filter->stc;
 	delete er_filter->ocr;
-	return 0;
+	delete er_filter->corrector;
+	delete er_filter->lexicon;
+	return ret;
 }
 
-int icdar_mode(ERFilter* er_filter)
+int icdar_mode(ERFilter* er_filter, bool show, char csv_file[])
 {
+	// headless unless asked, the sinks only get copies of the results
+	vector<ResultSink*> sinks;
+	sinks.push_back(new JsonLinesSink("icdar_result.jsonl"));
+	if (csv_file != nullptr)
+	{
+		CsvSink *csv = new CsvSink(csv_file);
+		if (!csv->is_open())
+		{
+			cerr << "ERROR! Unable to write " << csv_file << "\n";
+			delete csv;
+			for (auto it : sinks)
+				delete it;
+			return -1;
+		}
+		sinks.push_back(csv);
+	}
+	if (show)
+		sinks.push_back(new VisualizationSink("result"));
+
+	bool needs_image = false;
+	for (auto it : sinks)
+		needs_image |= it->needs_image();
+
 	int img_count = 0;
 	vector<double> avg_time(7, 0);
-	vector<vector<Text>> det_text;
 	for (int n = 1; n <= 328; n++)
 	{
 		Mat src;
-		Mat result;
 		if (!load_challenge2_test_file(src, n))	continue;
 
 		ERs root;
@@ -98,21 +235,37 @@ int icdar_mode(ERFilter* er_filter)
 		vector<Text> result_text;
 
 		vector<double> times = er_filter->text_detect(src, root, all, pool, strong, weak, tracked, result_text);
-		show_result(src, result, result_text, times, tracked, strong, weak, all, pool);
+
+		ResultRecord record;
+		record.source = "img_" + to_string(n);
+		record.index = n;
+		record.times = times;
+		make_text_result(result_text, record.text);
+		if (needs_image)
+			record.image = src;			// src is not touched after this point
+		for (auto it : sinks)
+			it->write(record);
+
+		for (auto it : root)
+			er_filter->er_delete(it);
 
 		++img_count;
 		for (int i = 0; i < times.size(); i++)
 			avg_time[i] += times[i];
 	}
 
-	cout << "Total frame number: " << img_count << "\n"
-		<< "ER extraction = " << avg_time[0] * 1000 / img_count << "ms\n"
-		<< "Non-maximum suppression = " << avg_time[1] * 1000 / img_count << "ms\n"
-		<< "Classification = " << avg_time[2] * 1000 / img_count << "ms\n"
-		<< "Character tracking = " << avg_time[3] * 1000 / img_count << "ms\n"
-		<< "Character grouping = " << avg_time[4] * 1000 / img_count << "ms\n"
-		<< "OCR = " << avg_time[5] * 1000 / img_count << "ms\n"
-		<< "Total execution time = " << avg_time[6] * 1000 / img_count << "ms\n\n";
+	for (auto it : sinks)
+	{
+		it->flush();
+		delete it;
+	}
+
+	if (img_count == 0)
+		return -1;
+
+	cout << "Total frame number: " << img_count << "\n";
+	Profiler::print_stage_time(cout, avg_time, img_count);
+	cout << endl;
 
 	return 0;
 }
@@ -138,9 +291,10 @@ int image_mode(ERFilter* er_filter, char filename[])
 	ERs tracked;
 	vector<Text> result_text;
 
+	// write every window to png, show_result waits for a key
+	set_show_option(false, true);
 	vector<double> times = er_filter->text_detect(src, root, all, pool, strong, weak, tracked, result_text);
 	show_result(src, result, result_text, times, tracked, strong, weak, all, pool);
-	waitKey(0);
 
 	return 0;
 }
@@ -174,6 +328,14 @@ int video_mode(ERFilter* er_filter, char filename[])
 	Mat result;
 	static vector<Text> result_text;
 	int key = -1;
+	set_show_option(true, false);
+
+	// the same signs are recognized frame after frame, reuse their OCR result
+	er_filter->ocr->enable_cache(OCR_CACHE_SIZE);
+	OCRCache *ocr_cache = er_filter->ocr->get_cache();
+
+	// lines keep the word of their track, OCR only runs on new, moved or uncertain lines
+	TextTrackManager track_manager;
 
 	chrono::high_resolution_clock::time_point start, end;
 	start = chrono::high_resolution_clock::now();
@@ -275,17 +437,21 @@ int video_mode(ERFilter* er_filter, char filename[])
 		vector<chrono::high_resolution_clock::time_point> time(3);
 
 		vector<Text> tmp_text;
-#ifndef DO_OCR
-		time[0] = chrono::high_resolution_clock::now();
-		er_filter->er_grouping(tracked_vec, text, true, true);
-		time[1] = chrono::high_resolution_clock::now();
-#else
-		time[0] = chrono::high_resolution_clock::now();
-		er_filter->er_grouping(tracked_vec, tmp_text, false, true);
-		time[1] = chrono::high_resolution_clock::now();
-		er_filter->er_ocr(tracked_vec, channel_vec, tmp_text);
-		time[2] = chrono::high_resolution_clock::now();
-#endif
+		if (!(er_filter->get_pipeline() & PIPELINE_OCR))
+		{
+			time[0] = chrono::high_resolution_clock::now();
+			er_filter->er_grouping(tracked_vec, tmp_text, true, true);
+			time[1] = chrono::high_resolution_clock::now();
+			time[2] = time[1];
+		}
+		else
+		{
+			time[0] = chrono::high_resolution_clock::now();
+			er_filter->er_grouping(tracked_vec, tmp_text, false, true);
+			time[1] = chrono::high_resolution_clock::now();
+			track_manager.update(er_filter, tracked_vec, channel_vec, tmp_text);
+			time[2] = chrono::high_resolution_clock::now();
+		}
 		result_text = tmp_text;
 
 		chrono::duration<double> grouping_time = (time[1] - time[0]);
@@ -306,24 +472,410 @@ int video_mode(ERFilter* er_filter, char filename[])
 	original_writer.release();
 	writer.release();
 
-	std::cout << "Total frame number: " << img_count << "\n"
-		<< "ER extraction = " << avg_time[0] * 1000 / img_count << "ms\n"
-		<< "Non-maximum suppression = " << avg_time[1] * 1000 / img_count << "ms\n"
-		<< "Classification = " << avg_time[2] * 1000 / img_count << "ms\n"
-		<< "Character tracking = " << avg_time[3] * 1000 / img_count << "ms\n"
-		<< "Character grouping = " << avg_time[4] * 1000 / img_count << "ms\n"
-		<< "OCR = " << avg_time[5] * 1000 / img_count << "ms\n"
-		<< "Total execution time = " << avg_time[6] * 1000 / img_count << "ms\n\n";
-
 	fstream fout("video_result/result/time_log.txt", fstream::out);
-	fout << "Total frame number: " << img_count << "\n"
-		<< "ER extraction = " << avg_time[0] * 1000 / img_count << "ms\n"
-		<< "Non-maximum suppression = " << avg_time[1] * 1000 / img_count << "ms\n"
-		<< "Classification = " << avg_time[2] * 1000 / img_count << "ms\n"
-		<< "Character tracking = " << avg_time[3] * 1000 / img_count << "ms\n"
-		<< "Character grouping = " << avg_time[4] * 1000 / img_count << "ms\n"
-		<< "OCR = " << avg_time[5] * 1000 / img_count << "ms\n"
-		<< "Total execution time = " << avg_time[6] * 1000 / img_count << "ms\n\n";
+	ostream *out[] = { &std::cout, &fout };
+	for (auto it : out)
+	{
+		*it << "Total frame number: " << img_count << "\n";
+		Profiler::print_stage_time(*it, avg_time, img_count);
+		*it << "OCR cache hits = " << ocr_cache->get_hits() << ", misses = " << ocr_cache->get_misses()
+			<< ", hit rate = " << ocr_cache->hit_rate() * 100 << "%\n"
+			<< "Text lines recognized = " << track_manager.get_ocr_count() << ", reused from tracks = " << track_manager.get_skip_count() << "\n\n";
+	}
+
+	return 0;
+}
+
+
+// Headless batch over the images of a directory, or of a text file with one path per line.
+// Decoding, detection + OCR and writing are pipeline stages joined by bounded queues: one decoder
+// thread, worker_num recognizer threads sharing one TextRecognizer, and one writer thread.
+// Every text line is written to batch_result.txt as "image,x1,y1,x2,y2,word".
+int batch_mode(char path[], int worker_num, int pipeline)
+{
+	struct BatchImage
+	{
+		string name;
+		Mat image;
+	};
+	struct BatchResult
+	{
+		string name;
+		vector<TextResult> text;
+	};
+
+	vector<string> files;
+	const string input(path);
+	if (input.size() > 4 && input.substr(input.size() - 4) == ".txt")
+	{
+		fstream fin(input, fstream::in);
+		string line;
+		while (getline(fin, line))
+		{
+			if (!line.empty())
+				files.push_back(line);
+		}
+	}
+	else
+	{
+		vector<String> found;
+		glob(input, found, false);
+		for (auto &it : found)
+		{
+			string ext = it.substr(it.find_last_of('.') + 1);
+			transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp")
+				files.push_back(it);
+		}
+	}
+
+	if (files.empty())
+	{
+		cerr << "ERROR! No image found in " << input << endl;
+		return -1;
+	}
 
+	TextRecognizer recognizer(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+	if (!recognizer.load_detector("er_classifier/strong.classifier", "er_classifier/weak.classifier") ||
+		!recognizer.load_ocr("ocr_classifier/OCR.model", "dictionary/tp_table.txt", OCR_IMG_L, OCR_FEATURE_L))
+	{
+		cerr << "ERROR! Unable to load the models\n";
+		return -1;
+	}
+	if (!recognizer.load_dictionary("dictionary/big.dict"))
+		recognizer.load_dictionary("dictionary/big.txt");
+	recognizer.load_lexicon("dictionary/big.lex");
+	recognizer.set_ocr_top_k(OCR_CANDIDATE_NUM);
+	recognizer.set_beam_width(OCR_BEAM_WIDTH);
+	recognizer.set_thread_num(1);	// the parallelism is across images
+	recognizer.set_pipeline(pipeline);
+
+	BoundedQueue<BatchImage> decoded(worker_num * 2);
+	BoundedQueue<BatchResult> recognized(worker_num * 2);
+	int image_count = 0;
+	int text_count = 0;
+
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	thread decoder([&]()
+	{
+		for (auto &file : files)
+		{
+			BatchImage item;
+			item.name = file;
+			item.image = imread(file, IMREAD_COLOR);
+			if (item.image.empty())
+			{
+				cerr << "Fail to open " << file << endl;
+				continue;
+			}
+			if (!decoded.push(move(item)))
+				break;
+		}
+		decoded.close();
+	});
+
+	vector<thread> workers;
+	for (int i = 0; i < worker_num; i++)
+	{
+		workers.push_back(thread([&]()
+		{
+			TextRecognizer::Context context;
+			BatchImage item;
+			while (decoded.pop(item))
+			{
+				BatchResult result;
+				result.name = item.name;
+				result.text = recognizer.recognize(item.image, context);
+				recognized.push(move(result));
+			}
+		}));
+	}
+
+	thread writer([&]()
+	{
+		fstream fout("batch_result.txt", fstream::out);
+		BatchResult result;
+		while (recognized.pop(result))
+		{
+			for (auto &it : result.text)
+			{
+				fout << result.name << ',' << it.box.x << ',' << it.box.y << ',' << it.box.br().x << ',' << it.box.br().y << ',' << it.word << '\n';
+			}
+			++image_count;
+			text_count += result.text.size();
+		}
+	});
+
+	decoder.join();
+	for (auto &it : workers)
+		it.join();
+	recognized.close();
+	writer.join();
+
+	const double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	cout << "Images: " << image_count << ", text lines: " << text_count << "\n"
+		<< "Workers: " << worker_num << ", elapsed = " << elapsed << "s, " << image_count / elapsed << " images/s\n"
+		<< "Decode queue: mean " << decoded.mean_occupancy() << " / " << decoded.get_capacity() << ", max " << decoded.max_occupancy()
+		<< ", decoder blocked " << decoded.get_full_wait() << " times, workers starved " << decoded.get_empty_wait() << " times\n"
+		<< "Result queue: mean " << recognized.mean_occupancy() << " / " << recognized.get_capacity() << ", max " << recognized.max_occupancy()
+		<< ", workers blocked " << recognized.get_full_wait() << " times, writer starved " << recognized.get_empty_wait() << " times\n";
+
+	return 0;
+}
+
+
+// Live stream: capture runs on its own thread into a LatestFrameBuffer and the processing always takes
+// the newest frame, frames that arrive while a frame is processed are dropped. A DetectionScheduler runs
+// the full detection on keyframes and tracks the text boxes in between. Results are drawn here,
+// encoding and disk writes are done by a background writer that also drops when it falls behind.
+// Reports the capture-to-result latency percentiles, which is what matters on a live camera.
+int live_mode(ERFilter* er_filter, char filename[])
+{
+	struct LiveOutput
+	{
+		unsigned long long index;
+		Mat input;
+		Mat result;
+		vector<string> words;
+	};
+
+	VideoCapture cap;
+	if (filename != nullptr)
+		cap = VideoCapture(filename);
+	else
+		cap = VideoCapture(0);
+
+	if (!cap.isOpened())
+	{
+		cerr << "ERROR! Unable to open camera or video file\n";
+		return -1;
+	}
+
+	LatestFrameBuffer frames;
+	atomic<bool> stop(false);
+	thread capture([&]()
+	{
+		unsigned long long index = 0;
+		while (!stop)
+		{
+			Frame &slot = frames.write_slot();
+			if (!cap.read(slot.image) || slot.image.empty())
+				break;
+			slot.capture_time = chrono::high_resolution_clock::now();
+			slot.index = index++;
+			frames.publish();
+		}
+		frames.close();
+	});
+
+	BoundedQueue<LiveOutput> output(8);
+	unsigned long long write_dropped = 0;
+	thread writer([&]()
+	{
+		VideoWriter result_writer;
+		VideoWriter input_writer;
+		fstream f_result_text("video_result/result/det.txt", fstream::out);
+		LiveOutput item;
+		while (output.pop(item))
+		{
+			if (!result_writer.isOpened())
+			{
+				result_writer.open("video_result/result/result.wmv", CV_FOURCC('W', 'M', 'V', '2'), 20.0, item.result.size(), true);
+				input_writer.open("video_result/result/input.wmv", CV_FOURCC('W', 'M', 'V', '2'), 20.0, item.input.size(), true);
+			}
+
+			char buf[60];
+			std::sprintf(buf, "video_result/result/%llu.jpg", item.index);
+			cv::imwrite(buf, item.result);
+			result_writer << item.result;
+			input_writer << item.input;
+
+			f_result_text << item.index;
+			for (auto &it : item.words)
+				f_result_text << "," << it;
+			f_result_text << endl;
+		}
+		result_writer.release();
+		input_writer.release();
+	});
+
+	// the same signs are recognized frame after frame, reuse their OCR result
+	er_filter->ocr->enable_cache(OCR_CACHE_SIZE);
+	DetectionScheduler scheduler(er_filter, LIVE_TARGET_FPS);
+
+	// keyframes give up quality before they blow the latency budget
+	QualityController quality(er_filter, LIVE_KEYFRAME_BUDGET, THRESHOLD_STEP, MIN_ER_AREA);
+
+	set_show_option(true, false);
+	vector<double> latency;
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	for (;;)
+	{
+		Frame *frame = frames.acquire();
+		if (frame == nullptr)
+		{
+			if (!frames.is_closed())
+			{
+				this_thread::sleep_for(chrono::milliseconds(1));
+				continue;
+			}
+
+			// the last frame may be published right before the capture closes
+			frame = frames.acquire();
+			if (frame == nullptr)
+				break;
+		}
+
+		vector<Text> text;
+		if (scheduler.process(frame->image, text))
+			quality.update(scheduler.get_detect_times());
+
+		LiveOutput item;
+		item.index = frame->index;
+		show_result(frame->image, item.result, text);
+		latency.push_back(chrono::duration<double>(chrono::high_resolution_clock::now() - frame->capture_time).count());
+
+		sort(text.begin(), text.end(), [](const Text &a, const Text &b) { return a.box.y < b.box.y; });
+		for (auto &it : text)
+			item.words.push_back(it.word);
+
+		// the slot goes back to the capture at the next acquire
+		item.input = frame->image.clone();
+		if (!output.try_push(move(item)))
+			++write_dropped;
+
+		if (waitKey(1) >= 0)
+			break;
+	}
+	const double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	stop = true;
+	capture.join();
+	output.close();
+	writer.join();
+	cap.release();
+
+	if (latency.empty())
+		return 0;
+
+	vector<double> sorted = latency;
+	sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p) { return sorted[min<size_t>(sorted.size() - 1, sorted.size() * p)] * 1000; };
+
+	std::cout << "Captured frames: " << frames.get_published() << "\n"
+		<< "Processed frames: " << latency.size() << " (" << latency.size() / elapsed << " fps)\n"
+		<< "Dropped by capture: " << frames.get_dropped() << ", dropped by writer: " << write_dropped << "\n"
+		<< "Keyframes: " << scheduler.get_keyframe_count() << " (" << scheduler.get_detect_time() * 1000 << "ms), tracked frames: "
+		<< scheduler.get_tracked_count() << " (" << scheduler.get_track_time() * 1000 << "ms), interval = " << scheduler.get_interval() << "\n"
+		<< "Keyframes over budget: " << quality.get_overrun_count() << ", quality changes: " << quality.get_change_count()
+		<< ", final detect level = " << quality.get_detect_level() << ", OCR level = " << quality.get_ocr_level() << "\n"
+		<< "Capture-to-result latency: p50 = " << percentile(0.5) << "ms, p90 = " << percentile(0.9)
+		<< "ms, p99 = " << percentile(0.99) << "ms, max = " << sorted.back() * 1000 << "ms\n";
+
+	return 0;
+}
+
+
+// Static camera: a ChangeDetector detects text again only in the regions that changed since the
+// reference frame. The fraction of the pixels processed is written for every frame to
+// video_result/result/processed_fraction.txt.
+int change_mode(ERFilter* er_filter, char filename[])
+{
+	VideoCapture cap;
+	if (filename != nullptr)
+		cap = VideoCapture(filename);
+	else
+		cap = VideoCapture(0);
+
+	if (!cap.isOpened())
+	{
+		cerr << "ERROR! Unable to open camera or video file\n";
+		return -1;
+	}
+
+	er_filter->ocr->enable_cache(OCR_CACHE_SIZE);
+	ChangeDetector detector(er_filter);
+	fstream f_fraction("video_result/result/processed_fraction.txt", fstream::out);
+
+	Mat frame;
+	Mat result;
+	int img_count = 0;
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	for (;;)
+	{
+		cap >> frame;
+		if (frame.empty())
+			break;
+
+		vector<Text> text;
+		detector.process(frame, text);
+		show_result(frame, result, text);
+		f_fraction << img_count << "\t" << detector.get_processed_fraction() << endl;
+		++img_count;
+
+		if (waitKey(1) >= 0)
+			break;
+	}
+	const double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	cap.release();
+
+	std::cout << "Total frame number: " << img_count << " (" << img_count / elapsed << " fps)\n"
+		<< "Mean fraction of pixels processed = " << detector.get_mean_processed_fraction() * 100 << "%\n";
+
+	return 0;
+}
+
+
+// Golden output of every stage on the ICDAR test set. record writes it, compare captures the output of
+// this build and configuration and reports the exact and tolerance-based differences of every stage
+// against the recorded one, so an optimized build can be checked against a reference build.
+int golden_mode(ERFilter* er_filter, char mode[], char filename[], int image_num)
+{
+	const bool record = (strcmp(mode, "record") == 0);
+	if (!record && strcmp(mode, "compare") != 0)
+	{
+		cerr << "ERROR! The golden mode is record or compare\n";
+		return -1;
+	}
+
+	GoldenOutput reference;
+	if (!record && !reference.read(filename))
+	{
+		cerr << "ERROR! Unable to read the golden output " << filename << "\n";
+		return -1;
+	}
+
+	GoldenOutput output;
+	int count = 0;
+	for (int n = 1; n <= 328 && count < image_num; n++)
+	{
+		Mat src;
+		if (!load_challenge2_test_file(src, n))	continue;
+		output.capture(er_filter, src, n);
+		++count;
+	}
+
+	if (record)
+	{
+		if (!output.write(filename))
+		{
+			cerr << "ERROR! Unable to write the golden output " << filename << "\n";
+			return -1;
+		}
+		std::cout << "Recorded " << count << " images to " << filename << endl;
+		return 0;
+	}
+
+	fstream f_diff("golden_diff.txt", fstream::out);
+	vector<GoldenOutput::StageDiff> diff = reference.compare(output, f_diff);
+	GoldenOutput::print_report(diff, std::cout);
+
+	// non-zero when a stage differs beyond the tolerance, for scripts
+	for (auto &it : diff)
+	{
+		if (it.tol_miss > 0)
+			return 1;
+	}
 	return 0;
 }
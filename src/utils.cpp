@@ -64,6 +64,16 @@ void load_video_thread(VideoCapture &cap, Mat frame, Mat result, static vector<T
 	return;
 }
 
+static bool show_fps = false;
+static bool save_result = false;
+
+// draw_FPS on the result window, and write every window to png and wait for a key
+void set_show_option(bool draw_fps, bool save_image)
+{
+	show_fps = draw_fps;
+	save_result = save_image;
+}
+
 void show_result(Mat& src, Mat& result_img, vector<Text> &text, vector<double> &times, ERs &tracked, vector<ERs> &strong, vector<ERs> &weak, vector<ERs> &all, vector<ERs> &pool)
 {
 	Mat all_img = src.clone();
@@ -121,34 +131,38 @@ void show_result(Mat& src, Mat& result_img, vector<Text> &text, vector<double> &
 
 	for (auto it : text)
 	{
-#ifndef DO_OCR
-		//rectangle(result_img, Rect(it.box.tl().x, it.box.tl().y-20, 53, 19), Scalar(30, 30, 200), CV_FILLED);
-		//putText(result_img, "Text", Point(it.box.tl().x, it.box.tl().y-4), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(255, 255, 255), 1);
-		circle(result_img, Point(it.box.tl().x + 5, it.box.tl().y - 12), 10, Scalar(30, 30, 200), CV_FILLED);
-		putText(result_img, "T", Point(it.box.tl().x - 2, it.box.tl().y - 5), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(255, 255, 255), 1);
-#else
+		// detection only, or a line the OCR was not run on
+		if (it.word.empty())
+		{
+			//rectangle(result_img, Rect(it.box.tl().x, it.box.tl().y-20, 53, 19), Scalar(30, 30, 200), CV_FILLED);
+			//putText(result_img, "Text", Point(it.box.tl().x, it.box.tl().y-4), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(255, 255, 255), 1);
+			circle(result_img, Point(it.box.tl().x + 5, it.box.tl().y - 12), 10, Scalar(30, 30, 200), CV_FILLED);
+			putText(result_img, "T", Point(it.box.tl().x - 2, it.box.tl().y - 5), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(255, 255, 255), 1);
+			continue;
+		}
+
 		Size text_size = getTextSize(it.word, FONT_HERSHEY_COMPLEX_SMALL, 1, 1, 0);
 		rectangle(result_img, Rect(it.box.tl().x, it.box.tl().y - 20, text_size.width, text_size.height + 5), Scalar(30, 30, 200, 0), CV_FILLED);
 		putText(result_img, it.word, Point(it.box.tl().x, it.box.tl().y - 4), FONT_HERSHEY_COMPLEX_SMALL, 1, Scalar(0xff, 0xff, 0xff), 1);
-#endif
 	}
 
 
-	if (!times.empty())
+	if (show_fps)
 	{
-	#if defined(WEBCAM_MODE) || defined(VIDEO_MODE)
-		draw_FPS(result_img, times.back());
-	#endif
+		// the modes that pass no stage times are timed from one result to the next
+		static chrono::high_resolution_clock::time_point last_show;
+		chrono::high_resolution_clock::time_point now = chrono::high_resolution_clock::now();
+		if (!times.empty())
+			draw_FPS(result_img, times.back());
+		else if (last_show.time_since_epoch().count() != 0)
+			draw_FPS(result_img, chrono::duration<double>(now - last_show).count());
+		last_show = now;
+	}
 
-		cout << "ER extraction = " << times[0] * 1000 << "ms\n"
-			<< "Non-maximum suppression = " << times[1] * 1000 << "ms\n"
-			<< "Classification = " << times[2] * 1000 << "ms\n"
-			<< "Character tracking = " << times[3] * 1000 << "ms\n"
-			<< "Character grouping = " << times[4] * 1000 << "ms\n"
-	#ifdef DO_OCR
-			<< "OCR = " << times[5] * 1000 << "ms\n"
-	#endif
-			<< "Total execution time = " << times[6] * 1000 << "ms\n\n";
+	if (!times.empty())
+	{
+		Profiler::print_stage_time(cout, times, 1);
+		cout << endl;
 	}
 
 	if (!all.empty())
@@ -168,20 +182,21 @@ void show_result(Mat& src, Mat& result_img, vector<Text> &text, vector<double> &
 	cv::imshow("result", result_img);
 	waitKey(1);
 
-#ifdef IMAGE_MODE
-	if (!all.empty())
-		imwrite("all.png", all_img);
-	if (!pool.empty())
-		imwrite("pool.png", pool_img);
-	if (!weak.empty())
-		imwrite("weak.png", weak_img);
-	if (!strong.empty())
-		imwrite("strong.png", strong_img);
-	if (!tracked.empty())
-		imwrite("tracked.png", tracked_img);
-	imwrite("result.png", result_img);
-	waitKey(0);
-#endif
+	if (save_result)
+	{
+		if (!all.empty())
+			imwrite("all.png", all_img);
+		if (!pool.empty())
+			imwrite("pool.png", pool_img);
+		if (!weak.empty())
+			imwrite("weak.png", weak_img);
+		if (!strong.empty())
+			imwrite("strong.png", strong_img);
+		if (!tracked.empty())
+			imwrite("tracked.png", tracked_img);
+		imwrite("result.png", result_img);
+		waitKey(0);
+	}
 	
 }
 
@@ -544,6 +559,622 @@ void output_optimal_path(string img_name)
 }
 
 
+// compare OCR::extract_feature_fused with OCR::extract_feature on the OCR training glyphs,
+// report the feature difference, the agreement of the SVM label and the time of both extractors
+void compare_chain_feature()
+{
+	const char *table = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz&()";	// 10 num, 52 alphabet, 3 symbol and 1 '\0'
+	vector<string> font_name = {
+		"Arial", "Bitter", "Calibri", "Cambria", "Coda", "Comic_Sans_MS", "Courier_New", "Domine", "Droid_Serif", "Fine_Ming",
+		"Gill_Sans", "Francois_One", "Georgia", "Impact", "Lato", "Neuton", "Open_Sans", "Oswald", "Oxygen", "Play", "PT_Serif", "Roboto_Slab", "Russo_One",
+		"Sans_Serif", "Syncopate", "Time_New_Roman", "Trebuchet_MS", "Twentieth_Century", "Ubuntu", "Verdana" };
+	vector<string> font_type = { "Bold", "Bold_and_Italic", "Italic", "Normal" };
+	vector<string> category = { "number", "upper", "lower", "symbol" };
+	vector<int> cat_num = { 10,26,26,3 };
+
+	OCR ocr("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	const int dims = 8 * OCR_FEATURE_L * OCR_FEATURE_L;
+	const int repeat = 20;
+
+	svm_node *fv = new svm_node[dims + 1];
+	vector<float> ref(dims);
+	vector<float> fused(dims);
+
+	int sample_count = 0;
+	int label_agree = 0;
+	double max_diff = 0;
+	double sum_diff = 0;
+	double sum_cos = 0;
+	chrono::duration<double> ref_time(0);
+	chrono::duration<double> fused_time(0);
+
+	for (int i = 0; i < font_name.size(); i++)
+	{
+		for (int j = 0; j < font_type.size(); j++)
+		{
+			int label = 0;
+			for (int k = 0; k < category.size(); k++)
+			{
+				string path = String("ocr_classifier/" + font_name[i] + "/" + font_type[j] + "/" + category[k] + "/");
+				for (int cat_it = 0; cat_it < cat_num[k]; cat_it++)
+				{
+					String filename = path + table[label] + ".jpg";
+					label++;
+
+					Mat img = imread(filename, IMREAD_GRAYSCALE);
+					if (img.empty())
+						continue;
+
+					Mat ocr_img;
+					threshold(255 - img, ocr_img, 200, 255, CV_THRESH_BINARY);
+					ocr.ARAN(ocr_img, ocr_img, OCR_IMG_L);
+
+					// findContours modifies its input, give every run its own copy
+					vector<Mat> copies(repeat);
+					for (int r = 0; r < repeat; r++)
+						copies[r] = ocr_img.clone();
+
+					chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+					for (int r = 0; r < repeat; r++)
+						ocr.extract_feature(copies[r], fv);
+					chrono::high_resolution_clock::time_point middle = chrono::high_resolution_clock::now();
+					for (int r = 0; r < repeat; r++)
+						ocr.extract_feature_fused(ocr_img, fused.data());
+					chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+					ref_time += middle - start;
+					fused_time += end - middle;
+
+					fill(ref.begin(), ref.end(), 0.0f);
+					for (int m = 0; fv[m].index != -1; m++)
+						ref[fv[m].index] = fv[m].value;
+
+					double dot = 0, norm_ref = 0, norm_fused = 0;
+					for (int d = 0; d < dims; d++)
+					{
+						const double diff = abs(ref[d] - fused[d]);
+						max_diff = max(max_diff, diff);
+						sum_diff += diff;
+						dot += ref[d] * fused[d];
+						norm_ref += ref[d] * ref[d];
+						norm_fused += fused[d] * fused[d];
+					}
+					sum_cos += (norm_ref > 0 && norm_fused > 0) ? dot / sqrt(norm_ref * norm_fused) : 1.0;
+
+					ocr.set_fused_feature(false);
+					const double ref_result = ocr.chain_run(img, 128);
+					ocr.set_fused_feature(true);
+					const double fused_result = ocr.chain_run(img, 128);
+					if (floor(ref_result) == floor(fused_result))
+						label_agree++;
+
+					sample_count++;
+				}
+			}
+		}
+	}
+	delete[] fv;
+
+	if (sample_count == 0)
+	{
+		cerr << "No OCR sample found in ocr_classifier/" << endl;
+		return;
+	}
+
+	std::cout << "Sample number: " << sample_count << "\n"
+		<< "Mean absolute difference = " << sum_diff / (sample_count * dims) << "\n"
+		<< "Max absolute difference = " << max_diff << "\n"
+		<< "Mean cosine similarity = " << sum_cos / sample_count << "\n"
+		<< "SVM label agreement = " << (double)label_agree / sample_count * 100 << "%\n"
+		<< "extract_feature = " << ref_time.count() * 1.0E6 / (sample_count * repeat) << "us\n"
+		<< "extract_feature_fused = " << fused_time.count() * 1.0E6 / (sample_count * repeat) << "us\n\n";
+}
+
+
+// accuracy and latency of the OCR backends on the glyphs of ocr_classifier/Other/ that train_ocr_knn holds out
+// (every OCR_TEST_FOLD-th one). train_ocr_model uses all of them, so the SVM result is optimistic.
+void compare_ocr_classifier()
+{
+	const char *table = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz&()";	// 10 num, 52 alphabet, 3 symbol and 1 '\0'
+	vector<string> category = { "number", "upper", "lower", "symbol" };
+	vector<int> cat_num = { 10,26,26,3 };
+
+	OCR ocr("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	shared_ptr<KNNClassifier> knn = make_shared<KNNClassifier>(OCR_IMG_L);
+	if (!knn->load("ocr_classifier/OCR_knn.bin"))
+	{
+		cerr << "Cannot load ocr_classifier/OCR_knn.bin, run train_ocr_knn() first" << endl;
+		return;
+	}
+
+	vector<Mat> glyphs;
+	vector<int> labels;
+	int label = 0;
+	for (int k = 0; k < category.size() - 1; k++)
+	{
+		for (int cat_it = 0; cat_it < cat_num[k]; cat_it++)
+		{
+			string path = string("ocr_classifier/Other/" + category[k] + "/" + table[label] + "/");
+			for (int i = OCR_TEST_FOLD - 1; i < 100; i += OCR_TEST_FOLD)
+			{
+				Mat img = imread(path + to_string(i) + ".jpg", IMREAD_GRAYSCALE);
+				if (img.empty())
+					continue;
+
+				Mat ocr_img;
+				threshold(255 - img, ocr_img, 200, 255, CV_THRESH_BINARY);
+				ocr.ARAN(ocr_img, ocr_img, OCR_IMG_L);
+				glyphs.push_back(ocr_img);
+				labels.push_back(label);
+			}
+			label++;
+		}
+	}
+
+	if (glyphs.empty())
+	{
+		cerr << "No OCR sample found in ocr_classifier/Other/" << endl;
+		return;
+	}
+
+	vector<OCRClassifier*> backends = { ocr.get_classifier(), knn.get() };
+	std::cout << "Sample number: " << glyphs.size() << ", kNN training samples: " << knn->size() << "\n";
+	for (auto backend : backends)
+	{
+		int correct = 0;
+		int correct_ignore_case = 0;
+		chrono::duration<double> time(0);
+		for (int i = 0; i < glyphs.size(); i++)
+		{
+			// backends may modify the glyph
+			Mat glyph = glyphs[i].clone();
+			double prob;
+
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			const int result = backend->predict(glyph, prob);
+			time += chrono::high_resolution_clock::now() - start;
+
+			if (result == labels[i])
+				correct++;
+			if (tolower(table[result]) == tolower(table[labels[i]]))
+				correct_ignore_case++;
+		}
+
+		std::cout << backend->name() << ": accuracy = " << (double)correct / glyphs.size() * 100 << "%, "
+			<< "case insensitive = " << (double)correct_ignore_case / glyphs.size() * 100 << "%, "
+			<< "latency = " << time.count() * 1.0E6 / glyphs.size() << "us\n";
+	}
+	std::cout << endl;
+}
+
+
+// accuracy vs speed of RFF models of several sizes against the SVM on ocr_classifier/OCR.data,
+// every RFF model is trained on the even samples and evaluated on the odd samples
+void report_ocr_compression()
+{
+	OCR ocr("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	SVMClassifier *svm = dynamic_cast<SVMClassifier*>(ocr.get_classifier());
+
+	Mat X;
+	vector<int> labels;
+	if (svm == nullptr || !load_ocr_data("ocr_classifier/OCR.data", X, labels))
+	{
+		cerr << "Cannot load ocr_classifier/OCR.model or ocr_classifier/OCR.data" << endl;
+		return;
+	}
+
+	// svm nodes and SVM output of every sample, a row keeps only its non-zero nodes and the terminator
+	const int classes = svm_get_nr_class(svm->get_model());
+	vector<vector<svm_node>> nodes(X.rows);
+	vector<svm_node> dense_node(ocr.get_feature_dim() + 1);
+	vector<int> svm_label(X.rows);
+	Mat P(X.rows, classes, CV_32F);
+	chrono::duration<double> svm_time(0);
+	for (int n = 0; n < X.rows; n++)
+	{
+		const int nnz = ocr.dense_to_svm_node(X.ptr<float>(n), dense_node.data());
+		nodes[n].assign(dense_node.begin(), dense_node.begin() + nnz + 1);
+
+		vector<double> prob;
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		svm->predict_prob(nodes[n].data(), prob);
+		svm_time += chrono::high_resolution_clock::now() - start;
+
+		svm_label[n] = max_element(prob.begin(), prob.end()) - prob.begin();
+		for (int k = 0; k < classes; k++)
+			P.at<float>(n, k) = prob[k];
+	}
+
+	Mat X_train, P_train;
+	vector<int> test;
+	for (int n = 0; n < X.rows; n++)
+	{
+		if (n % 2 == 0)
+		{
+			X_train.push_back(X.row(n));
+			P_train.push_back(P.row(n));
+		}
+		else
+			test.push_back(n);
+	}
+
+	int svm_correct = 0;
+	for (auto n : test)
+		svm_correct += (svm_label[n] == labels[n]);
+
+	fstream fout("ocr_classifier/compression_report.txt", fstream::out);
+	std::cout << "Sample number: " << X.rows << " (train " << X_train.rows << ", test " << test.size() << ")\n";
+	fout << "model\taccuracy\tagreement\tlatency(us)\n";
+	std::cout << "SVM (" << svm->get_model()->l << " SVs): accuracy = " << (double)svm_correct / test.size() * 100 << "%, "
+		<< "latency = " << svm_time.count() * 1.0E6 / X.rows << "us\n";
+	fout << "SVM\t" << (double)svm_correct / test.size() << "\t1\t" << svm_time.count() * 1.0E6 / X.rows << "\n";
+
+	const int dims[] = { 128, 256, 512, 1024, 2048 };
+	for (auto D : dims)
+	{
+		RFFClassifier rff(&ocr);
+		rff.fit(X_train, P_train, svm->get_model()->param.gamma, D);
+
+		int correct = 0;
+		int agree = 0;
+		chrono::duration<double> time(0);
+		for (auto n : test)
+		{
+			double prob;
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			const int label = rff.predict(nodes[n].data(), prob);
+			time += chrono::high_resolution_clock::now() - start;
+
+			correct += (label == labels[n]);
+			agree += (label == svm_label[n]);
+		}
+
+		std::cout << "RFF D=" << D << ": accuracy = " << (double)correct / test.size() * 100 << "%, "
+			<< "SVM agreement = " << (double)agree / test.size() * 100 << "%, "
+			<< "latency = " << time.count() * 1.0E6 / test.size() << "us\n";
+		fout << "RFF" << D << "\t" << (double)correct / test.size() << "\t" << (double)agree / test.size() << "\t" << time.count() * 1.0E6 / test.size() << "\n";
+	}
+	std::cout << endl;
+	fout.close();
+}
+
+
+// per-line decode latency of solve_graph (k = 1) and beam_search against the OCR top-k on the ICDAR test set
+void benchmark_lattice_decode()
+{
+	ERFilter* er_filter = new ERFilter(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+	er_filter->stc = new CascadeBoost("er_classifier/strong.classifier");
+	er_filter->wtc = new CascadeBoost("er_classifier/weak.classifier");
+	er_filter->ocr = new OCR("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	er_filter->load_tp_table("dictionary/tp_table.txt");
+	er_filter->corrector = new SpellingCorrector();
+	if (!er_filter->corrector->load("dictionary/big.dict"))
+		er_filter->corrector->load("dictionary/big.txt");
+	er_filter->set_beam_width(OCR_BEAM_WIDTH);
+
+	vector<Mat> images;
+	for (int n = 1; n <= 233; n++)
+	{
+		Mat src;
+		if (load_challenge2_test_file(src, n))
+			images.push_back(src);
+	}
+
+	fstream fout("decode_latency.txt", fstream::out);
+	fout << "k\tlines\tmean(us)\tp50(us)\tp99(us)\tmax(us)\n";
+
+	const int top_k[] = { 1, 2, 3, 5, 8 };
+	for (auto k : top_k)
+	{
+		er_filter->set_ocr_top_k(k);
+
+		vector<double> latency;
+		for (auto &src : images)
+		{
+			ERs root;
+			vector<ERs> all;
+			vector<ERs> pool;
+			vector<ERs> strong;
+			vector<ERs> weak;
+			ERs tracked;
+			vector<Text> text;
+			er_filter->text_detect(src, root, all, pool, strong, weak, tracked, text);
+
+			const vector<double> &decode_time = er_filter->get_decode_time();
+			latency.insert(latency.end(), decode_time.begin(), decode_time.end());
+
+			for (auto it : root)
+				er_filter->er_delete(it);
+		}
+
+		if (latency.empty())
+			continue;
+
+		sort(latency.begin(), latency.end());
+		const double mean = accumulate(latency.begin(), latency.end(), 0.0) / latency.size();
+		const double p50 = latency[latency.size() / 2];
+		const double p99 = latency[min<size_t>(latency.size() - 1, latency.size() * 99 / 100)];
+
+		std::cout << "k = " << k << ", beam = " << OCR_BEAM_WIDTH << ", lines = " << latency.size()
+			<< ", mean = " << mean * 1.0E6 << "us, p50 = " << p50 * 1.0E6 << "us, p99 = " << p99 * 1.0E6
+			<< "us, max = " << latency.back() * 1.0E6 << "us\n";
+		fout << k << "\t" << latency.size() << "\t" << mean * 1.0E6 << "\t" << p50 * 1.0E6 << "\t" << p99 * 1.0E6 << "\t" << latency.back() * 1.0E6 << "\n";
+	}
+	std::cout << endl;
+	fout.close();
+
+	delete er_filter->stc;
+	delete er_filter->wtc;
+	delete er_filter->ocr;
+	delete er_filter->corrector;
+	delete er_filter;
+}
+
+
+// throughput of one shared TextRecognizer called from 1 ~ hardware_concurrency threads on the ICDAR test set.
+// Every call runs single-threaded inside, the threads pull images from a shared counter, and the words of
+// every image are compared with the single-thread run to catch any state shared between calls.
+void benchmark_recognizer_scaling()
+{
+	TextRecognizer recognizer(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+	if (!recognizer.load_detector("er_classifier/strong.classifier", "er_classifier/weak.classifier") ||
+		!recognizer.load_ocr("ocr_classifier/OCR.model", "dictionary/tp_table.txt", OCR_IMG_L, OCR_FEATURE_L))
+	{
+		cerr << "Cannot load the models" << endl;
+		return;
+	}
+	if (!recognizer.load_dictionary("dictionary/big.dict"))
+		recognizer.load_dictionary("dictionary/big.txt");
+	recognizer.load_lexicon("dictionary/big.lex");
+	recognizer.set_ocr_top_k(OCR_CANDIDATE_NUM);
+	recognizer.set_beam_width(OCR_BEAM_WIDTH);
+	recognizer.set_thread_num(1);
+
+	vector<Mat> images;
+	for (int n = 1; n <= 233; n++)
+	{
+		Mat src;
+		if (load_challenge2_test_file(src, n))
+			images.push_back(src);
+	}
+	if (images.empty())
+		return;
+
+	vector<string> reference(images.size());
+	const int max_threads = max(1u, thread::hardware_concurrency());
+	const int repeat = 2;
+
+	fstream fout("recognizer_scaling.txt", fstream::out);
+	fout << "threads\timages/s\tspeedup\tefficiency\tmismatch\n";
+
+	// 1, 2, 4, ... and max_threads itself when it is not a power of 2
+	vector<int> thread_nums;
+	for (int n = 1; n < max_threads; n *= 2)
+		thread_nums.push_back(n);
+	thread_nums.push_back(max_threads);
+
+	double base_throughput = 0;
+	for (auto thread_num : thread_nums)
+	{
+		vector<string> words(images.size());
+		atomic<int> next(0);
+		const int total = images.size() * repeat;
+
+		auto worker = [&]()
+		{
+			TextRecognizer::Context context;
+			for (int n = next++; n < total; n = next++)
+			{
+				const int i = n % images.size();
+				vector<TextResult> result = recognizer.recognize(images[i], context);
+				if (n < images.size())
+				{
+					for (auto &it : result)
+						words[i] += it.word + ' ';
+				}
+			}
+		};
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		vector<thread> pool;
+		for (int t = 0; t < thread_num; t++)
+			pool.push_back(thread(worker));
+		for (auto &it : pool)
+			it.join();
+		const double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+		if (thread_num == 1)
+			reference = words;
+		int mismatch = 0;
+		for (int i = 0; i < images.size(); i++)
+			mismatch += (words[i] != reference[i]);
+
+		const double throughput = total / elapsed;
+		if (thread_num == 1)
+			base_throughput = throughput;
+		const double speedup = throughput / base_throughput;
+
+		std::cout << "threads = " << thread_num << ", " << throughput << " images/s, speedup = " << speedup
+			<< ", efficiency = " << speedup / thread_num << ", mismatch = " << mismatch << endl;
+		fout << thread_num << "\t" << throughput << "\t" << speedup << "\t" << speedup / thread_num << "\t" << mismatch << "\n";
+	}
+	fout.close();
+}
+
+
+// Differential check of the fast paths that already exist against the plain pipeline on the ICDAR
+// test set: the reference runs one thread with the original chain-code feature and no OCR cache,
+// the optimized one the fused feature, the OCR cache and all OpenMP threads. The report is printed
+// and written to golden_report.txt, the first differences of every stage to golden_diff.txt.
+void compare_golden_config()
+{
+	const int image_num = 50;
+	ERFilter* er_filter[2];
+	for (int k = 0; k < 2; k++)
+	{
+		er_filter[k] = new ERFilter(THRESHOLD_STEP, MIN_ER_AREA, MAX_ER_AREA, NMS_STABILITY_T, NMS_OVERLAP_COEF, MIN_OCR_PROBABILITY);
+		er_filter[k]->stc = new CascadeBoost("er_classifier/strong.classifier");
+		er_filter[k]->wtc = new CascadeBoost("er_classifier/weak.classifier");
+		er_filter[k]->ocr = new OCR("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+		er_filter[k]->load_tp_table("dictionary/tp_table.txt");
+		er_filter[k]->set_ocr_top_k(OCR_CANDIDATE_NUM);
+		er_filter[k]->set_beam_width(OCR_BEAM_WIDTH);
+	}
+	er_filter[0]->set_thread_num(1);
+	er_filter[0]->ocr->set_fused_feature(false);
+	er_filter[1]->set_thread_num(0);
+	er_filter[1]->ocr->set_fused_feature(true);
+	er_filter[1]->ocr->enable_cache(OCR_CACHE_SIZE);
+
+	GoldenOutput reference;
+	GoldenOutput optimized;
+	int count = 0;
+	for (int n = 1; n <= 328 && count < image_num; n++)
+	{
+		Mat src;
+		if (!load_challenge2_test_file(src, n))	continue;
+		reference.capture(er_filter[0], src, n);
+		optimized.capture(er_filter[1], src, n);
+		++count;
+	}
+
+	fstream f_diff("golden_diff.txt", fstream::out);
+	vector<GoldenOutput::StageDiff> diff = reference.compare(optimized, f_diff);
+	fstream f_report("golden_report.txt", fstream::out);
+	GoldenOutput::print_report(diff, std::cout);
+	GoldenOutput::print_report(diff, f_report);
+
+	for (int k = 0; k < 2; k++)
+	{
+		delete er_filter[k]->stc;
+		delete er_filter[k]->wtc;
+		delete er_filter[k]->ocr;
+		delete er_filter[k];
+	}
+}
+
+
+// Checks the Levenshtein automaton of Lexicon against the edit distance to every word of
+// dictionary/dictionary1.txt. The queries are words with 0 ~ max_edit + 1 random edits. After every
+// letter, step must stay alive exactly when a word has a prefix within max_edit edits of the text and
+// its cheapest state must be that distance; at the end final_cost must be the distance to the closest word.
+void verify_lexicon()
+{
+	const int query_num = 400;
+	fstream fin("dictionary/dictionary1.txt", fstream::in);
+	if (!fin.is_open())
+	{
+		cerr << "Cannot open dictionary/dictionary1.txt" << endl;
+		return;
+	}
+
+	// the same tokenization as Lexicon::load
+	vector<string> words;
+	string line;
+	while (getline(fin, line))
+	{
+		string word;
+		for (auto ch : line + " ")
+		{
+			if (isalpha((unsigned char)ch))
+				word += tolower(ch);
+			else if (!word.empty())
+			{
+				words.push_back(word);
+				word.clear();
+			}
+		}
+	}
+	sort(words.begin(), words.end());
+	words.erase(unique(words.begin(), words.end()), words.end());
+
+	Lexicon lexicon;
+	vector<string> build_words(words);
+	lexicon.build(build_words);
+
+	mt19937 rng(0x1E7);
+	for (int max_edit = 1; max_edit <= 2; max_edit++)
+	{
+		int wrong_alive = 0;
+		int wrong_cost = 0;
+		int wrong_final = 0;
+		for (int q = 0; q < query_num; q++)
+		{
+			string query = words[rng() % words.size()];
+			const int edit_num = rng() % (max_edit + 2);
+			for (int e = 0; e < edit_num; e++)
+			{
+				const int op = rng() % 3;
+				const char letter = 'a' + rng() % 26;
+				const int pos = rng() % (query.size() + 1);
+				if (op == 0)
+					query.insert(query.begin() + pos, letter);
+				else if (pos < (int)query.size() && query.size() > 1)
+					(op == 1) ? (void)query.erase(query.begin() + pos) : (void)(query[pos] = letter);
+			}
+
+			// prefix_cost[i]: edits between the first i letters and the closest word prefix, full_cost: to the closest word
+			const int m = query.size();
+			vector<int> prefix_cost(m + 1, INT_MAX);
+			int full_cost = INT_MAX;
+#pragma omp parallel
+			{
+				vector<int> local_prefix(m + 1, INT_MAX);
+				int local_full = INT_MAX;
+				vector<int> row, prev;
+#pragma omp for
+				for (int w = 0; w < words.size(); w++)
+				{
+					// column j of row i is the distance between query[0, i) and word[0, j)
+					const string &word = words[w];
+					const int n = word.size();
+					prev.resize(n + 1);
+					row.resize(n + 1);
+					for (int j = 0; j <= n; j++)
+						prev[j] = j;
+					local_prefix[0] = 0;
+					for (int i = 1; i <= m; i++)
+					{
+						row[0] = i;
+						for (int j = 1; j <= n; j++)
+							row[j] = min(min(prev[j] + 1, row[j - 1] + 1), prev[j - 1] + (query[i - 1] != word[j - 1]));
+						local_prefix[i] = min(local_prefix[i], *min_element(row.begin(), row.end()));
+						swap(row, prev);
+					}
+					local_full = min(local_full, prev[n]);
+				}
+#pragma omp critical
+				{
+					for (int i = 0; i <= m; i++)
+						prefix_cost[i] = min(prefix_cost[i], local_prefix[i]);
+					full_cost = min(full_cost, local_full);
+				}
+			}
+
+			vector<Lexicon::State> states, next;
+			lexicon.start(states, max_edit);
+			bool alive = true;
+			for (int i = 1; i <= m && alive; i++)
+			{
+				alive = lexicon.step(states.data(), states.size(), query[i - 1], next, max_edit);
+				states.swap(next);
+				if (alive != (prefix_cost[i] <= max_edit))
+				{
+					if (wrong_alive++ < 10)
+						std::cout << "K=" << max_edit << " \"" << query << "\" prefix " << i << ": step " << (alive ? "alive" : "dead") << ", distance " << prefix_cost[i] << "\n";
+				}
+				else if (alive && states.front().cost != prefix_cost[i])
+					wrong_cost++;
+			}
+			if (alive && lexicon.final_cost(states.data(), states.size(), max_edit) != min(full_cost, max_edit + 1))
+				wrong_final++;
+		}
+
+		std::cout << "K=" << max_edit << ": " << query_num << " queries, wrong alive = " << wrong_alive << ", wrong prefix cost = " << wrong_cost
+			<< ", wrong final cost = " << wrong_final << endl;
+	}
+}
+
+
 vector<Vec4i> load_gt(int n)
 {
 	char filename[50];
@@ -1027,17 +1658,17 @@ void calc_video_result()
 	}
 		
 
-	double correct_thresh = 0.7;
-	int gt_count = 0;
-	int det_count = 0;
-	int tp = 0;
-	int fp = 0;
-	int fn = 0;
-	for (int i = 0; i < gt.size(); i++)
-	{
-		gt_count += gt[i].size() - 1;
-		det_count += det[i].size() - 1;
+	// frames are matched independently, every frame writes its own counts and they are summed in
+	// frame order afterwards, so the result does not depend on the thread count
+	const double correct_thresh = 0.7;
+	const int frame_num = gt.size();
+	vector<int> frame_tp(frame_num, 0);
+	vector<int> frame_fp(frame_num, 0);
+	vector<int> frame_fn(frame_num, 0);
 
+#pragma omp parallel for schedule(dynamic, 16)
+	for (int i = 0; i < frame_num; i++)
+	{
 		vector<bool> gt_is_match(gt[i].size(), false);
 		vector<bool> det_is_match(det[i].size(), false);
 		for (int j = 1; j < det[i].size(); j++)
@@ -1058,18 +1689,32 @@ void calc_video_result()
 		for (int k = 1; k < gt_is_match.size(); k++)
 		{
 			if (!gt_is_match[k])
-				fn++;
+				frame_fn[i]++;
 		}
 
 		for (int j = 1; j < det_is_match.size(); j++)
 		{
 			if (det_is_match[j])
-				tp++;
+				frame_tp[i]++;
 			else
-				fp++;
+				frame_fp[i]++;
 		}
 	}
 
+	int gt_count = 0;
+	int det_count = 0;
+	int tp = 0;
+	int fp = 0;
+	int fn = 0;
+	for (int i = 0; i < frame_num; i++)
+	{
+		gt_count += gt[i].size() - 1;
+		det_count += det[i].size() - 1;
+		tp += frame_tp[i];
+		fp += frame_fp[i];
+		fn += frame_fn[i];
+	}
+
 	double recall = tp / (double)gt_count;
 	double precision = tp / (double)det_count;
 	double f_score = 2 * recall*precision / (recall + precision);
@@ -1134,8 +1779,12 @@ void train_cascade()
 	TrainingData *td1 = new TrainingData();
 	TrainingData *tmp = new TrainingData();
 	TrainingData *td2 = new TrainingData();
-	AdaBoost *adb1 = new CascadeBoost(AdaBoost::REAL, AdaBoost::DECISION_STUMP, Ftarget1, f1, d1);
-	AdaBoost *adb2 = new CascadeBoost(AdaBoost::REAL, AdaBoost::DECISION_STUMP, Ftarget2, f2, d2);
+	CascadeBoost *adb1 = new CascadeBoost(AdaBoost::REAL, AdaBoost::DECISION_STUMP, Ftarget1, f1, d1);
+	CascadeBoost *adb2 = new CascadeBoost(AdaBoost::REAL, AdaBoost::DECISION_STUMP, Ftarget2, f2, d2);
+
+	// the LBP counts have at most 145 values per dim, the histogram search gives the same stumps
+	adb1->set_max_bin(256);
+	adb2->set_max_bin(256);
 
 	freopen("er_classifier/log.txt", "w", stdout);
 
@@ -1291,7 +1940,7 @@ void rotate_ocr_samples()
 	vector<string> category = { "number", "upper", "lower", "symbol" };
 	vector<int> cat_num = { 10,26,26,3 };
 
-	OCR ocr = OCR();
+	OCR ocr;
 	int n = 0;
 	double rad = 0 / 180.0*CV_PI;
 	for (int i = 0; i < font_name.size(); i++)
@@ -1444,6 +2093,218 @@ void train_ocr_model()
 }
 
 
+// store the normalized binary glyphs of the OCR training set (fonts and Other) for KNNClassifier,
+// every OCR_TEST_FOLD-th glyph of Other is left for compare_ocr_classifier
+void train_ocr_knn()
+{
+	const char *table = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz&()";	// 10 num, 52 alphabet, 3 symbol and 1 '\0'
+	vector<string> font_name = {
+		"Arial", "Bitter", "Calibri", "Cambria", "Coda", "Comic_Sans_MS", "Courier_New", "Domine", "Droid_Serif", "Fine_Ming",
+		"Gill_Sans", "Francois_One", "Georgia", "Impact", "Lato", "Neuton", "Open_Sans", "Oswald", "Oxygen", "Play", "PT_Serif", "Roboto_Slab", "Russo_One",
+		"Sans_Serif", "Syncopate", "Time_New_Roman", "Trebuchet_MS", "Twentieth_Century", "Ubuntu", "Verdana" };
+	vector<string> font_type = { "Bold", "Bold_and_Italic", "Italic", "Normal" };
+	vector<string> category = { "number", "upper", "lower", "symbol" };
+	vector<int> cat_num = { 10,26,26,3 };
+
+	OCR ocr;
+	KNNClassifier knn(OCR_IMG_L);
+
+	for (int i = 0; i < font_name.size(); i++)
+	{
+		for (int j = 0; j < font_type.size(); j++)
+		{
+			int label = 0;
+			for (int k = 0; k < category.size(); k++)
+			{
+				string path = String("ocr_classifier/" + font_name[i] + "/" + font_type[j] + "/" + category[k] + "/");
+				for (int cat_it = 0; cat_it < cat_num[k]; cat_it++)
+				{
+					String filename = path + table[label] + ".jpg";
+					label++;
+
+					Mat img = imread(filename, IMREAD_GRAYSCALE);
+					if (img.empty())
+					{
+						cout << filename << " not exist!" << endl;
+						continue;
+					}
+
+					Mat ocr_img;
+					threshold(255 - img, ocr_img, 200, 255, CV_THRESH_BINARY);
+					ocr.ARAN(ocr_img, ocr_img, OCR_IMG_L);
+					knn.add_sample(ocr_img, label - 1);
+				}
+			}
+		}
+	}
+
+	// for Other
+	int label = 0;
+	for (int k = 0; k < category.size() - 1; k++)
+	{
+		for (int cat_it = 0; cat_it < cat_num[k]; cat_it++)
+		{
+			string path = string("ocr_classifier/Other/" + category[k] + "/" + table[label] + "/");
+			label++;
+			for (int i = 0; i < 100; i++)
+			{
+				if (i % OCR_TEST_FOLD == OCR_TEST_FOLD - 1)
+					continue;
+
+				Mat img = imread(path + to_string(i) + ".jpg", IMREAD_GRAYSCALE);
+				if (img.empty())
+					continue;
+
+				Mat ocr_img;
+				threshold(255 - img, ocr_img, 200, 255, CV_THRESH_BINARY);
+				ocr.ARAN(ocr_img, ocr_img, OCR_IMG_L);
+				knn.add_sample(ocr_img, label - 1);
+			}
+		}
+	}
+
+	if (knn.save("ocr_classifier/OCR_knn.bin"))
+		cout << knn.size() << " glyphs saved to ocr_classifier/OCR_knn.bin" << endl;
+	else
+		cerr << "Cannot write ocr_classifier/OCR_knn.bin" << endl;
+}
+
+
+// read the libsvm format feature file written by train_ocr_model into dense rows
+bool load_ocr_data(string filename, Mat &X, vector<int> &labels)
+{
+	fstream fin(filename, fstream::in);
+	if (!fin.is_open())
+		return false;
+
+	const int dims = 8 * OCR_FEATURE_L * OCR_FEATURE_L;
+	X.release();
+	labels.clear();
+
+	string line;
+	while (getline(fin, line))
+	{
+		if (line.empty())
+			continue;
+
+		istringstream iss(line);
+		int label;
+		iss >> label;
+
+		Mat row = Mat::zeros(1, dims, CV_32F);
+		string pair;
+		while (iss >> pair)
+		{
+			const size_t colon = pair.find(':');
+			const int index = stoi(pair.substr(0, colon));
+			if (index >= 0 && index < dims)
+				row.at<float>(0, index) = stof(pair.substr(colon + 1));
+		}
+
+		X.push_back(row);
+		labels.push_back(label);
+	}
+
+	return !labels.empty();
+}
+
+
+// distill ocr_classifier/OCR.model into an RFF model of D random features (ocr_classifier/OCR_rff.model),
+// pass that file to the OCR constructor to use it, see report_ocr_compression to choose D
+void compress_ocr_model(const int D)
+{
+	OCR ocr("ocr_classifier/OCR.model", OCR_IMG_L, OCR_FEATURE_L);
+	SVMClassifier *svm = dynamic_cast<SVMClassifier*>(ocr.get_classifier());
+
+	Mat X;
+	vector<int> labels;
+	if (svm == nullptr || !load_ocr_data("ocr_classifier/OCR.data", X, labels))
+	{
+		cerr << "Cannot load ocr_classifier/OCR.model or ocr_classifier/OCR.data" << endl;
+		return;
+	}
+
+	const int classes = svm_get_nr_class(svm->get_model());
+	Mat P(X.rows, classes, CV_32F);
+	svm_node *fv = new svm_node[X.cols + 1];
+	for (int n = 0; n < X.rows; n++)
+	{
+		vector<double> prob;
+		ocr.dense_to_svm_node(X.ptr<float>(n), fv);
+		svm->predict_prob(fv, prob);
+		for (int k = 0; k < classes; k++)
+			P.at<float>(n, k) = prob[k];
+	}
+	delete[] fv;
+
+	cout << "training RFF model, D = " << D << "..." << endl;
+	RFFClassifier rff(&ocr);
+	rff.fit(X, P, svm->get_model()->param.gamma, D);
+	if (rff.save("ocr_classifier/OCR_rff.model"))
+		cout << "saved to ocr_classifier/OCR_rff.model" << endl;
+	else
+		cerr << "Cannot write ocr_classifier/OCR_rff.model" << endl;
+}
+
+
+// compile dictionary/big.txt into dictionary/big.dict, which SpellingCorrector::load maps without parsing
+void compile_dictionary()
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	SpellingCorrector corrector;
+	if (!corrector.load("dictionary/big.txt"))
+	{
+		cerr << "Cannot open dictionary/big.txt" << endl;
+		return;
+	}
+	chrono::high_resolution_clock::time_point middle = chrono::high_resolution_clock::now();
+
+	if (!corrector.compile("dictionary/big.dict"))
+	{
+		cerr << "Cannot write dictionary/big.dict" << endl;
+		return;
+	}
+
+	SpellingCorrector compiled;
+	chrono::high_resolution_clock::time_point map_start = chrono::high_resolution_clock::now();
+	compiled.load("dictionary/big.dict");
+	chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+
+	cout << corrector.size() << " words compiled" << endl
+		<< "load text: " << chrono::duration<double>(middle - start).count() * 1000 << "ms" << endl
+		<< "load compiled: " << chrono::duration<double>(end - map_start).count() * 1000 << "ms" << endl;
+}
+
+
+// compile the words of dictionary/big.txt into the trie dictionary/big.lex used by the lexicon-constrained decoding
+void compile_lexicon()
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	Lexicon lexicon;
+	if (!lexicon.load("dictionary/big.txt"))
+	{
+		cerr << "Cannot open dictionary/big.txt" << endl;
+		return;
+	}
+	chrono::high_resolution_clock::time_point middle = chrono::high_resolution_clock::now();
+
+	if (!lexicon.save("dictionary/big.lex"))
+	{
+		cerr << "Cannot write dictionary/big.lex" << endl;
+		return;
+	}
+
+	Lexicon compiled;
+	chrono::high_resolution_clock::time_point load_start = chrono::high_resolution_clock::now();
+	compiled.load("dictionary/big.lex");
+	chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+
+	cout << lexicon.size() << " words, " << lexicon.node_num() << " trie nodes" << endl
+		<< "build: " << chrono::duration<double>(middle - start).count() * 1000 << "ms" << endl
+		<< "load compiled: " << chrono::duration<double>(end - load_start).count() * 1000 << "ms" << endl;
+}
+
+
 void extract_ocr_sample()
 {
 	string path = "ocr_classifier/Calibri/Normal/";
@@ -1489,61 +2350,90 @@ void opencv_train()
 
 
 
-// solve levenshtein distance(edit distance) by dynamic programming, 
-// check https://vinayakgarg.wordpress.com/2012/12/10/edit-distance-using-dynamic-programming/ for more info
-int levenshtein_distance(string str1, string str2)
+// levenshtein distance (edit distance) by the bit-parallel algorithm of
+// G. Myers, "A fast bit-vector algorithm for approximate string matching based on dynamic programming", 1999,
+// in the global distance form of H. Hyyro, "A bit-vector algorithm for computing Levenshtein and Damerau edit distances", 2003.
+// Every column of the DP matrix is a vertical delta vector of the shorter string, one machine word
+// covers 64 rows, so a pair of words up to 64 letters takes O(n) word operations and no allocation.
+int levenshtein_distance(const string &str1, const string &str2)
 {
-#define INSERT_COST 1
-#define DELETE_COST 1
-#define REPLACE_COST 1
-
-	// cost matrix
-	// row -> str1 & col -> str2
-	int size1 = str1.size();
-	int size2 = str2.size();
-	vector<vector<int>> cost(size1, vector<int>(size2));
-	int i, j;
-
-	// initialize the cost matrix
-	for (i = 0; i<size1; i++) 
+	const string &p = (str1.size() <= str2.size()) ? str1 : str2;	// pattern, the rows
+	const string &t = (str1.size() <= str2.size()) ? str2 : str1;	// text, the columns
+	const int m = p.size();
+	const int n = t.size();
+	if (m == 0)
+		return n;
+
+	typedef unsigned long long word;
+	const int blocks = (m + 63) / 64;
+	const word last = 1ull << ((m - 1) % 64);
+
+	if (blocks == 1)
 	{
-		for (j = 0; j<size2; j++) 
+		word peq[256] = { 0 };
+		for (int i = 0; i < m; i++)
+			peq[(unsigned char)p[i]] |= 1ull << i;
+
+		word pv = ~0ull;
+		word mv = 0;
+		int score = m;
+		for (int j = 0; j < n; j++)
 		{
-			if (i == 0) 
-			{
-				// source string is NULL
-				// so we need 'j' insert operations
-				cost[i][j] = j*INSERT_COST;
-			}
-			else if (j == 0) 
-			{
-				// target string is NULL
-				// so we need 'i' delete operations
-				cost[i][j] = i*DELETE_COST;
-			}
-			else 
-			{
-				cost[i][j] = -1;
-			}
+			const word eq = peq[(unsigned char)t[j]];
+			const word xv = eq | mv;
+			const word xh = (((eq & pv) + pv) ^ pv) | eq;
+			word ph = mv | ~(xh | pv);
+			word mh = pv & xh;
+			if (ph & last)
+				score++;
+			else if (mh & last)
+				score--;
+
+			// the first row grows by 1 every column
+			ph = (ph << 1) | 1;
+			mh <<= 1;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
 		}
+		return score;
 	}
-	
-	//compute cost(i,j) and eventually return cost(m,n)
-	for (i = 1; i<size1; i++) 
+
+	// longer strings: the blocks of a column are chained by the horizontal delta leaving their last row
+	vector<word> peq(256 * blocks, 0);
+	for (int i = 0; i < m; i++)
+		peq[(unsigned char)p[i] * blocks + i / 64] |= 1ull << (i % 64);
+
+	vector<word> pv(blocks, ~0ull);
+	vector<word> mv(blocks, 0);
+	int score = m;
+	for (int j = 0; j < n; j++)
 	{
-		for (j = 1; j<size2; j++) 
+		const word *eq_column = &peq[(unsigned char)t[j] * blocks];
+		int h = 1;
+		for (int b = 0; b < blocks; b++)
 		{
-			int x = cost[i - 1][j] + DELETE_COST;
-			int y = cost[i][j - 1] + INSERT_COST;
-			// if str1(i-1) != str2(j-1), add the replace cost
-			// we are comparing str1[i-1] and str2[j-1] since
-			// the array index starts from 0
-			int z = cost[i - 1][j - 1] + (str1[i - 1] != str2[j - 1])*REPLACE_COST;
-			// as per our recursive formula
-			cost[i][j] = min(x, min(y, z));
+			word eq = eq_column[b];
+			const word xv = eq | mv[b];
+			if (h < 0)
+				eq |= 1;
+			const word xh = (((eq & pv[b]) + pv[b]) ^ pv[b]) | eq;
+			word ph = mv[b] | ~(xh | pv[b]);
+			word mh = pv[b] & xh;
+
+			const word high = (b == blocks - 1) ? last : 1ull << 63;
+			const int h_out = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+
+			ph <<= 1;
+			mh <<= 1;
+			if (h < 0)
+				mh |= 1;
+			else if (h > 0)
+				ph |= 1;
+			pv[b] = mh | ~(xv | ph);
+			mv[b] = ph & xv;
+			h = h_out;
 		}
+		score += h;
 	}
-
-	// last cell of the matrix holds the answer
-	return cost[size1 - 1][size2 - 1];
-}
\ No newline at end of file
+	return score;
+}